@@ -0,0 +1,53 @@
+# 数据层性能基准测试（独立控制台程序，不依赖界面）
+# 用法: warehouse_bench --products 10000 --records 100000 --out bench_results.json
+
+QT       += core gui sql concurrent
+QT       -= widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# 在线备份的复制方式与主程序相同（见 warehouse.pro）
+packagesExist(sqlite3) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += sqlite3
+    DEFINES += WAREHOUSE_SQLITE_API
+}
+
+TARGET = warehouse_bench
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../csvreader.cpp \
+    ../datasnapshot.cpp \
+    ../dataworker.cpp \
+    ../dbmanager.cpp \
+    ../forecaster.cpp \
+    ../locationstock.cpp \
+    ../lowstockmonitor.cpp \
+    ../metrics.cpp \
+    ../productmodel.cpp \
+    ../recordmodel.cpp \
+    ../reportengine.cpp \
+    ../requestkeyfilter.cpp \
+    ../snapshotfile.cpp \
+    ../timelinemodel.cpp
+
+HEADERS += \
+    ../csvreader.h \
+    ../datasnapshot.h \
+    ../dataworker.h \
+    ../dbmanager.h \
+    ../forecaster.h \
+    ../locationstock.h \
+    ../lowstockmonitor.h \
+    ../metrics.h \
+    ../productmodel.h \
+    ../recordmodel.h \
+    ../reportengine.h \
+    ../requestkeyfilter.h \
+    ../snapshotfile.h \
+    ../timelinemodel.h \
+    ../warehousedata.h
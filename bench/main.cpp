@@ -0,0 +1,547 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QSortFilterProxyModel>
+#include <QEventLoop>
+#include <QTimer>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDateTime>
+#include <QDebug>
+#include <algorithm>
+#include "dbmanager.h"
+#include "dataworker.h"
+#include "productmodel.h"
+#include "recordmodel.h"
+#include "timelinemodel.h"
+#include "forecaster.h"
+#include "reportengine.h"
+#include "datasnapshot.h"
+
+// 单项测试结果
+struct BenchResult {
+    QString name;
+    qint64 rows;             // 每次迭代处理的行数（用于计算吞吐）
+    QVector<double> samples; // 每次迭代耗时 (ms)
+    int failures;            // 失败而未计入样本的迭代次数
+};
+
+static QList<BenchResult> g_results;
+static bool g_failed = false; // 有任一次迭代失败时基准测试以非零状态退出
+
+//执行 fn 若干次并记录耗时，fn 返回本次处理的行数；返回负数表示本次失败，耗时不计入样本
+template <typename Fn>
+static void measure(const QString &name, int iterations, Fn fn) {
+    BenchResult r;
+    r.name = name;
+    r.rows = 0;
+    r.failures = 0;
+    for (int i = 0; i < iterations; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        const qint64 rows = fn(i);
+        const double ms = timer.nsecsElapsed() / 1e6;
+        if (rows < 0) {
+            r.failures++;
+            continue;
+        }
+        r.rows = rows;
+        r.samples.append(ms);
+    }
+    g_results.append(r);
+
+    if (r.failures > 0) {
+        g_failed = true;
+        qWarning().noquote() << QString("%1  FAILED %2 of %3 iterations").arg(name, -32).arg(r.failures).arg(iterations);
+    }
+    if (r.samples.isEmpty()) return;
+    QVector<double> sorted = r.samples;
+    std::sort(sorted.begin(), sorted.end());
+    qInfo().noquote() << QString("%1  median %2 ms  (%3 rows)")
+                             .arg(name, -32).arg(sorted.at(sorted.size() / 2), 0, 'f', 2).arg(r.rows);
+}
+
+static QJsonObject toJson(const BenchResult &r) {
+    QJsonObject o;
+    o["name"] = r.name;
+    o["failures"] = r.failures;
+    if (r.samples.isEmpty()) return o;
+
+    QVector<double> sorted = r.samples;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0;
+    for (double v : sorted) sum += v;
+    double median = sorted.at(sorted.size() / 2);
+
+    QJsonArray samples;
+    for (double v : r.samples) samples.append(v);
+
+    o["rows"] = r.rows;
+    o["min_ms"] = sorted.first();
+    o["median_ms"] = median;
+    o["mean_ms"] = sum / sorted.size();
+    o["max_ms"] = sorted.last();
+    o["rows_per_sec"] = median > 0 ? r.rows / (median / 1000.0) : 0.0;
+    o["samples_ms"] = samples;
+    return o;
+}
+
+//生成合成仓库数据：products 个货品，records 条出入库记录（时间分布在最近一年内）
+static bool generateWarehouse(int products, int records) {
+    QSqlDatabase db = QSqlDatabase::database();
+    QRandomGenerator rng(20240601);
+    const QStringList categories = {"电子产品", "办公用品", "原材料", "食品", "其他"};
+
+    db.transaction();
+    QSqlQuery query;
+    query.prepare("INSERT INTO products (code, name, category, unit, price, quantity, min_stock) "
+                  "VALUES (?, ?, ?, ?, ?, ?, ?)");
+    for (int i = 0; i < products; ++i) {
+        query.addBindValue(QString("SKU%1").arg(i, 7, 10, QChar('0')));
+        query.addBindValue(QString("货品%1").arg(i));
+        query.addBindValue(categories.at(i % categories.size()));
+        query.addBindValue("个");
+        query.addBindValue(rng.bounded(10000) / 100.0);
+        query.addBindValue(int(rng.bounded(1000)));
+        query.addBindValue(int(rng.bounded(100)));
+        if (!query.exec()) {
+            qWarning() << "Generate products failed:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+
+    const qint64 now = QDateTime::currentDateTime().toSecsSinceEpoch();
+    query.prepare("INSERT INTO records (product_id, type, count, timestamp, remark) "
+                  "VALUES (?, ?, ?, ?, ?)");
+    for (int i = 0; i < records; ++i) {
+        query.addBindValue(int(rng.bounded(products)) + 1);
+        query.addBindValue(int(rng.bounded(2)));
+        query.addBindValue(int(rng.bounded(1, 50)));
+        query.addBindValue(now - qint64(rng.bounded(365 * 24 * 3600)));
+        query.addBindValue(QString("订单%1").arg(i));
+        if (!query.exec()) {
+            qWarning() << "Generate records failed:" << query.lastError().text();
+            db.rollback();
+            return false;
+        }
+    }
+    return db.commit();
+}
+
+//改为冗余存储之前的历史加载方式：每次关联货品表和仓库表取名称，用来对比
+static qint64 loadRecordsWithJoin() {
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.exec("SELECT r.id, r.product_id, p.code, p.name, r.type, r.count, r.timestamp, r.remark, "
+               "r.location_id, r.peer_location_id, l.name FROM records r "
+               "LEFT JOIN products p ON r.product_id = p.id "
+               "LEFT JOIN locations l ON r.location_id = l.id "
+               "ORDER BY r.timestamp DESC");
+    QList<Record> list;
+    while (query.next()) {
+        Record r;
+        r.id = query.value(0).toInt();
+        r.productId = query.value(1).toInt();
+        r.productCode = query.value(2).toString();
+        r.productName = query.value(3).toString();
+        r.type = query.value(4).toInt();
+        r.count = query.value(5).toInt();
+        r.time = QDateTime::fromSecsSinceEpoch(query.value(6).toLongLong());
+        r.remark = query.value(7).toString();
+        r.locationId = query.value(8).toInt();
+        r.peerLocationId = query.value(9).toInt();
+        r.locationName = query.value(10).toString();
+        list.append(r);
+    }
+    return list.size();
+}
+
+//任务结束时把结果写入 *ok，失败时打印原因（在工作线程中直接调用）
+static void watchWorker(DataWorker *worker, bool *ok) {
+    *ok = false;
+    QObject::connect(worker, &DataWorker::taskFinished, worker,
+                     [ok](bool success, QString msg) {
+                         *ok = success;
+                         if (!success) qWarning() << msg;
+                     }, Qt::DirectConnection);
+}
+
+//在当前线程同步跑完一个后台任务
+static bool runWorker(TaskType type, const QString &path, const DataSnapshotPtr &snapshot = DataSnapshotPtr(),
+                      bool compress = false) {
+    bool ok = false;
+    DataWorker worker;
+    worker.setTask(type, path);
+    worker.setSnapshot(snapshot);
+    worker.setCompression(compress);
+    watchWorker(&worker, &ok);
+    worker.start();
+    worker.wait();
+    //导入直接改写了数据库，与界面一样让共享快照失效
+    if (type == TaskType::ImportStock || type == TaskType::ImportSnapshot)
+        SnapshotStore::instance().invalidate();
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("仓库数据层性能基准测试");
+    parser.addHelpOption();
+    QCommandLineOption productsOpt("products", "合成货品数量", "n", "10000");
+    QCommandLineOption recordsOpt("records", "合成出入库记录数量", "n", "100000");
+    QCommandLineOption iterOpt("iterations", "每项测试的迭代次数", "n", "5");
+    QCommandLineOption batchOpt("batch", "单次出入库测试的操作条数", "n", "1000");
+    QCommandLineOption outOpt("out", "结果 JSON 文件", "file", "bench_results.json");
+    QCommandLineOption dbOpt("db", "基准测试使用的数据库文件（会被覆盖）", "file",
+                             QDir::temp().filePath("warehouse_bench.db"));
+    parser.addOptions({productsOpt, recordsOpt, iterOpt, batchOpt, outOpt, dbOpt});
+    parser.process(app);
+
+    const int products = qMax(1, parser.value(productsOpt).toInt());
+    const int records = qMax(0, parser.value(recordsOpt).toInt());
+    const int iterations = qMax(1, parser.value(iterOpt).toInt());
+    const int batch = qMax(1, parser.value(batchOpt).toInt());
+    const QString dbPath = parser.value(dbOpt);
+
+    QFile::remove(dbPath);
+    if (!DbManager::instance().init(dbPath)) {
+        qCritical() << "无法初始化数据库" << dbPath;
+        return 1;
+    }
+
+    QElapsedTimer genTimer;
+    genTimer.start();
+    if (!generateWarehouse(products, records)) return 1;
+    DbManager::instance().reconcileStockLevels();
+    DbManager::instance().waitForFullText();
+    qInfo() << "generated" << products << "products," << records << "records in"
+            << genTimer.elapsed() << "ms";
+
+    DbManager &db = DbManager::instance();
+    QRandomGenerator rng(42);
+
+    //合成记录没有冗余的货品名称，相当于一次旧库升级（例如 --records 5000000）
+    measure("backfillRecordProducts", 1, [&](int) {
+        db.backfillRecordProducts();
+        return qint64(records);
+    });
+
+    // --- 数据层查询 ---
+    measure("getAllProducts", iterations, [&](int) {
+        return qint64(db.getAllProducts().size());
+    });
+    measure("getAllRecords", iterations, [&](int) {
+        return qint64(db.getAllRecords().size());
+    });
+    measure("getAllRecords_join", iterations, [&](int) {
+        return loadRecordsWithJoin();
+    });
+
+    // --- 记录搜索：全文索引 vs LIKE 全表扫描（搜索一个只出现在少数记录备注里的订单号）---
+    const int searchRuns = 100;
+    measure("searchRecords_fts", iterations, [&](int) {
+        qint64 found = 0;
+        for (int i = 0; i < searchRuns; ++i)
+            found += db.searchRecords(QString("订单%1").arg(rng.bounded(qMax(1, records))), 0, 200).size();
+        return found;
+    });
+    measure("searchRecords_like", iterations, [&](int) {
+        QSqlQuery query;
+        query.prepare("SELECT id FROM records WHERE remark LIKE ? ORDER BY timestamp DESC LIMIT 200");
+        qint64 found = 0;
+        for (int i = 0; i < searchRuns; ++i) {
+            query.addBindValue(QString("%订单%1%").arg(rng.bounded(qMax(1, records))));
+            query.exec();
+            while (query.next()) found++;
+        }
+        return found;
+    });
+
+    // --- 出入库 ---
+    measure("adjustStock_single", iterations, [&](int) {
+        for (int i = 0; i < batch; ++i)
+            db.adjustStock(int(rng.bounded(products)) + 1, 1, true, "bench");
+        return qint64(batch);
+    });
+    measure("adjustStock_batched", iterations, [&](int) {
+        QList<StockMovement> moves;
+        moves.reserve(batch);
+        for (int i = 0; i < batch; ++i)
+            moves.append({int(rng.bounded(products)) + 1, 1, true, "bench"});
+        db.adjustStockBatch(moves);
+        return qint64(batch);
+    });
+
+    //带幂等键的批量出入库：第一遍写入，第二遍原样重放（全部应被内存窗口拦下）
+    int keyRound = 0;
+    QList<StockMovement> keyed;
+    measure("adjustStock_batched_keyed", iterations, [&](int) {
+        keyed.clear();
+        keyed.reserve(batch);
+        for (int i = 0; i < batch; ++i) {
+            StockMovement m{int(rng.bounded(products)) + 1, 1, true, "bench"};
+            m.requestKey = QString("bench-%1-%2").arg(keyRound).arg(i);
+            keyed.append(m);
+        }
+        keyRound++;
+        db.adjustStockBatch(keyed);
+        return qint64(batch);
+    });
+    measure("adjustStock_batched_replay", iterations, [&](int) {
+        db.adjustStockBatch(keyed);
+        return qint64(batch);
+    });
+
+    //第二个仓库：调拨及分仓出入库
+    Location second;
+    second.code = "BENCH2";
+    second.name = "基准测试仓";
+    db.addLocation(second);
+    const int secondId = db.getLocations().last().id;
+    measure("transferStock", iterations, [&](int) {
+        for (int i = 0; i < batch; ++i)
+            db.transferStock(int(rng.bounded(products)) + 1, DefaultLocationId, secondId, 1, "bench");
+        return qint64(batch);
+    });
+    measure("adjustStock_batched_second_location", iterations, [&](int) {
+        QList<StockMovement> moves;
+        moves.reserve(batch);
+        for (int i = 0; i < batch; ++i)
+            moves.append({int(rng.bounded(products)) + 1, 1, true, "bench", secondId});
+        db.adjustStockBatch(moves);
+        return qint64(batch);
+    });
+
+    // --- CSV 导入导出 ---
+    const QString stockCsv = QDir::temp().filePath("warehouse_bench_stock.csv");
+    const QString recordCsv = QDir::temp().filePath("warehouse_bench_records.csv");
+    const QString importCsv = QDir::temp().filePath("warehouse_bench_import.csv");
+
+    measure("exportStock_csv", iterations, [&](int) {
+        return runWorker(TaskType::ExportStock, stockCsv) ? qint64(products) : -1;
+    });
+    measure("exportRecord_csv", iterations, [&](int) {
+        return runWorker(TaskType::ExportRecord, recordCsv) ? qint64(records) : -1;
+    });
+
+    //共享快照：冷加载一次，之后导出直接读内存，出入库提交只复制被改到的块
+    measure("snapshot_load_all", 1, [&](int) {
+        SnapshotStore::instance().invalidate();
+        DataSnapshotPtr snapshot = SnapshotStore::instance().acquire(true);
+        return qint64(snapshot->products.size() + snapshot->records.size());
+    });
+    measure("exportStock_csv_snapshot", iterations, [&](int) {
+        return runWorker(TaskType::ExportStock, stockCsv, SnapshotStore::instance().acquire(false)) ? qint64(products) : -1;
+    });
+    measure("exportRecord_csv_snapshot", iterations, [&](int) {
+        return runWorker(TaskType::ExportRecord, recordCsv, SnapshotStore::instance().acquire(true)) ? qint64(records) : -1;
+    });
+    measure("adjustStock_single_with_snapshot", iterations, [&](int) {
+        for (int i = 0; i < batch; ++i)
+            db.adjustStock(int(rng.bounded(products)) + 1, 1, true, "bench");
+        return qint64(batch);
+    });
+
+    const int importRows = qMin(products, 10000);
+    measure("importStock_csv", iterations, [&](int iter) {
+        //每轮使用不同的编号，避免与已有货品冲突
+        QFile f(importCsv);
+        if (f.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            QTextStream out(&f);
+            out << "ID,编号,名称,分类,单位,单价,库存数量,预警阈值\n";
+            for (int i = 0; i < importRows; ++i)
+                out << i << ",IMP" << iter << "-" << i << ",导入货品" << i
+                    << ",原材料,个,9.90,100,10\n";
+        }
+        f.close();
+        return runWorker(TaskType::ImportStock, importCsv) ? qint64(importRows) : -1;
+    });
+
+    // --- 二进制快照 ---
+    const QString snapshotPath = QDir::temp().filePath("warehouse_bench.whsz");
+    measure("exportSnapshot_compressed", iterations, [&](int) {
+        return runWorker(TaskType::ExportSnapshot, snapshotPath, DataSnapshotPtr(), true) ? qint64(products + records) : -1;
+    });
+    measure("importSnapshot", iterations, [&](int) {
+        return runWorker(TaskType::ImportSnapshot, snapshotPath) ? qint64(products + records) : -1;
+    });
+
+    // --- 在线备份：备份进行期间持续出入库，记录单次出入库的最长等待 ---
+    const QString backupPath = QDir::temp().filePath("warehouse_bench.whbk");
+    //复制在后台线程进行，出入库由主线程的定时器穿插执行，与界面中的情形相同
+    measure("backup_online_compressed", iterations, [&](int) {
+        DataWorker worker;
+        worker.setTask(TaskType::Backup, backupPath);
+        bool ok = false;
+        watchWorker(&worker, &ok);
+        double maxMs = 0;
+        int moves = 0;
+        QTimer mover;
+        QObject::connect(&mover, &QTimer::timeout, [&] {
+            QElapsedTimer t;
+            t.start();
+            db.adjustStock(int(rng.bounded(products)) + 1, 1, true, "bench");
+            maxMs = qMax(maxMs, t.nsecsElapsed() / 1e6);
+            moves++;
+        });
+        QEventLoop loop;
+        QObject::connect(&worker, &QThread::finished, &loop, &QEventLoop::quit);
+        mover.start(1);
+        worker.start();
+        loop.exec();
+        mover.stop();
+        worker.wait();
+        if (!ok) return qint64(-1);
+        qInfo().noquote() << QString("  %1 movements during backup, max adjustStock %2 ms").arg(moves).arg(maxMs, 0, 'f', 2);
+        return qint64(QFileInfo(backupPath).size());
+    });
+
+    // --- 历史库存 ---
+    db.createCheckpoint();
+    measure("getStockAt_30d_ago", iterations, [&](int) {
+        return qint64(db.getStockAt(QDateTime::currentDateTime().addDays(-30)).size());
+    });
+    measure("getStockAt_300d_ago", iterations, [&](int) {
+        return qint64(db.getStockAt(QDateTime::currentDateTime().addDays(-300)).size());
+    });
+
+    // --- 补货预测 ---
+    measure("forecast_reload", iterations, [&](int) {
+        Forecaster::instance().reload();
+        return qint64(records);
+    });
+
+    // --- 报表（每轮先失效缓存，测的是重新加载 + 并行聚合） ---
+    ReportEngine &reports = ReportEngine::instance();
+    const QDateTime yearAgo = QDateTime::currentDateTime().addDays(-365);
+    const QDateTime now = QDateTime::currentDateTime();
+    measure("report_load_and_value_by_category", iterations, [&](int) {
+        reports.invalidateAll();
+        return qint64(reports.stockValueByCategory().rows.size());
+    });
+    measure("report_movements_by_month", iterations, [&](int iter) {
+        return qint64(reports.movementsByPeriod(ReportPeriod::Month, yearAgo.addSecs(iter), now).rows.size());
+    });
+    measure("report_top_movers", iterations, [&](int iter) {
+        return qint64(reports.topMovers(yearAgo.addSecs(iter), now, 20).rows.size());
+    });
+
+    // --- 模型刷新与过滤 ---
+    ProductModel productModel;
+    RecordModel recordModel;
+    measure("ProductModel_reload", iterations, [&](int) {
+        productModel.reload();
+        return qint64(productModel.rowCount());
+    });
+
+    //调价：逐个 updateProduct（每个一次提交）对比在模型中批量暂存后一个事务写入全部货品
+    measure("updateProduct_single", iterations, [&](int) {
+        for (int i = 0; i < batch; ++i) {
+            Product p = db.getProductById(int(rng.bounded(products)) + 1);
+            p.price += 0.01;
+            db.updateProduct(p);
+        }
+        return qint64(batch);
+    });
+    measure("ProductModel_bulk_reprice_save", iterations, [&](int) {
+        productModel.reload();
+        QList<int> rows;
+        rows.reserve(productModel.rowCount());
+        for (int i = 0; i < productModel.rowCount(); ++i) rows << i;
+        productModel.scalePrices(rows, 1.0);
+        const QList<Product> changed = productModel.pendingChanges();
+        db.updateProductsBatch(changed);
+        productModel.clearPending();
+        return qint64(changed.size());
+    });
+
+    //启动路径：后台分页加载的第一页、全部加载完成，以及首屏缓存
+    measure("startup_products_first_page", iterations, [&](int) {
+        QEventLoop loop;
+        QObject::connect(&productModel, &QAbstractItemModel::modelReset, &loop, &QEventLoop::quit);
+        productModel.reloadAsync();
+        loop.exec();
+        return qint64(productModel.rowCount());
+    });
+    measure("startup_products_all_pages", iterations, [&](int) {
+        QEventLoop loop;
+        QObject::connect(&productModel, &ProductModel::loadFinished, &loop, &QEventLoop::quit);
+        productModel.reloadAsync();
+        loop.exec();
+        return qint64(productModel.rowCount());
+    });
+    const QString cachePath = QDir::temp().filePath("warehouse_bench.firstscreen");
+    productModel.saveCache(cachePath);
+    measure("startup_first_screen_cache", iterations, [&](int) {
+        productModel.loadCache(cachePath);
+        return qint64(productModel.rowCount());
+    });
+    productModel.reload();
+
+    measure("RecordModel_reload", iterations, [&](int) {
+        recordModel.reload();
+        return qint64(recordModel.rowCount());
+    });
+
+    //货品流水：打开（第一页）与一路滚动到底
+    TimelineModel timeline;
+    const Product first = db.getProductById(1);
+    measure("timeline_first_page", iterations, [&](int) {
+        timeline.setProduct(first.id, first.quantity);
+        return qint64(timeline.rowCount());
+    });
+    measure("timeline_fetch_all", iterations, [&](int) {
+        timeline.setProduct(first.id, first.quantity);
+        while (timeline.canFetchMore(QModelIndex())) timeline.fetchMore(QModelIndex());
+        return qint64(timeline.rowCount());
+    });
+
+    QSortFilterProxyModel proxy;
+    proxy.setSourceModel(&productModel);
+    proxy.setFilterKeyColumn(2);
+    proxy.setFilterCaseSensitivity(Qt::CaseInsensitive);
+    const QStringList patterns = {"1", "12", "123", "货品99", ""};
+    measure("proxy_filter", iterations, [&](int) {
+        for (const QString &p : patterns)
+            proxy.setFilterFixedString(p);
+        return qint64(productModel.rowCount()) * patterns.size();
+    });
+
+    // --- 输出结果 ---
+    QJsonObject meta;
+    meta["qt_version"] = QString(qVersion());
+    meta["products"] = products;
+    meta["records"] = records;
+    meta["iterations"] = iterations;
+    meta["batch"] = batch;
+    meta["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+
+    QJsonArray results;
+    for (const BenchResult &r : g_results) results.append(toJson(r));
+
+    QJsonObject root;
+    root["meta"] = meta;
+    root["results"] = results;
+
+    QFile out(parser.value(outOpt));
+    if (!out.open(QIODevice::WriteOnly)) {
+        qCritical() << "无法写入结果文件" << out.fileName();
+        return 1;
+    }
+    out.write(QJsonDocument(root).toJson());
+    qInfo() << "results written to" << out.fileName();
+    return g_failed ? 1 : 0;
+}
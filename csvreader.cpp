@@ -0,0 +1,129 @@
+#include "csvreader.h"
+#include <QIODevice>
+
+CsvReader::CsvReader(QIODevice *in, int bufferSize)
+    : m_in(in), m_pos(0), m_len(0), m_consumed(0), m_line(1),
+      m_atStart(true), m_eof(false), m_skipLf(false)
+{
+    m_buf.resize(bufferSize);
+}
+
+bool CsvReader::fill() {
+    if (m_eof) return false;
+    const qint64 n = m_in->read(m_buf.data(), m_buf.size());
+    if (n <= 0) {
+        m_eof = true;
+        m_len = m_pos = 0;
+        return false;
+    }
+    m_len = int(n);
+    m_pos = 0;
+
+    //跳过文件开头的 UTF-8 BOM
+    if (m_atStart) {
+        m_atStart = false;
+        if (m_len >= 3 && uchar(m_buf[0]) == 0xEF && uchar(m_buf[1]) == 0xBB && uchar(m_buf[2]) == 0xBF) {
+            m_pos = 3;
+            m_consumed += 3;
+        }
+    }
+    return true;
+}
+
+bool CsvReader::readRow(CsvRow *row) {
+    enum State { FieldStart, Unquoted, Quoted, QuoteInQuoted };
+
+    row->data.clear();
+    row->bounds.clear();
+    row->raw.clear();
+
+    State state = FieldStart;
+    int fieldBegin = 0;
+    bool started = false;
+
+    for (;;) {
+        if (m_pos >= m_len && !fill()) break;
+
+        const char *p = m_buf.constData();
+        const char c = p[m_pos];
+
+        if (m_skipLf) {
+            m_skipLf = false;
+            if (c == '\n') {
+                m_pos++;
+                m_consumed++;
+                continue;
+            }
+        }
+        if (!started) {
+            started = true;
+            row->lineNumber = m_line;
+        }
+        m_pos++;
+        m_consumed++;
+
+        if (state == Quoted) {
+            if (c == '"') {
+                state = QuoteInQuoted;
+            } else {
+                if (c == '\n') m_line++;
+                row->data.append(c);
+            }
+            row->raw.append(c);
+            continue;
+        }
+        if (state == QuoteInQuoted) {
+            if (c == '"') { // "" 转义为一个引号
+                row->data.append('"');
+                row->raw.append(c);
+                state = Quoted;
+                continue;
+            }
+            state = Unquoted; // 引号已闭合，继续按普通字段处理
+        }
+
+        if (c == ',') {
+            row->bounds << fieldBegin << row->data.size();
+            fieldBegin = row->data.size();
+            row->raw.append(c);
+            state = FieldStart;
+        } else if (c == '\n' || c == '\r') {
+            m_line++;
+            m_skipLf = (c == '\r');
+            row->bounds << fieldBegin << row->data.size();
+            return true;
+        } else if (c == '"' && state == FieldStart) {
+            row->raw.append(c);
+            state = Quoted;
+        } else {
+            //普通字符：一次拷贝到下一个分隔符为止，避免逐字节追加
+            int end = m_pos;
+            while (end < m_len) {
+                const char d = p[end];
+                if (d == ',' || d == '\n' || d == '\r' || d == '"') break;
+                ++end;
+            }
+            row->data.append(c);
+            row->data.append(p + m_pos, end - m_pos);
+            row->raw.append(c);
+            row->raw.append(p + m_pos, end - m_pos);
+            m_consumed += end - m_pos;
+            m_pos = end;
+            state = Unquoted;
+        }
+    }
+
+    //文件结束：最后一行可能没有换行符
+    if (!started) return false;
+    row->bounds << fieldBegin << row->data.size();
+    return true;
+}
+
+QString csvEscape(const QString &field) {
+    if (!field.contains(QLatin1Char(',')) && !field.contains(QLatin1Char('"'))
+        && !field.contains(QLatin1Char('\n')) && !field.contains(QLatin1Char('\r')))
+        return field;
+    QString escaped = field;
+    escaped.replace(QLatin1String("\""), QLatin1String("\"\""));
+    return QLatin1Char('"') + escaped + QLatin1Char('"');
+}
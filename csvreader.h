@@ -0,0 +1,56 @@
+#ifndef CSVREADER_H
+#define CSVREADER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QIODevice;
+
+// 一行 CSV 的解析结果：字段内容连续存放在 data 中，bounds 记录每个字段的起止位置
+// 行对象在读取过程中反复复用，不为每个字段单独分配内存
+struct CsvRow {
+    QByteArray data;
+    QVector<int> bounds;   // [begin0, end0, begin1, end1, ...]
+    QByteArray raw;        // 原始行文本（不含行尾），用于记录被拒绝的行
+    qint64 lineNumber = 0; // 该行在文件中的起始行号（从 1 开始）
+
+    int size() const { return bounds.size() / 2; }
+    QString field(int i) const {
+        if (i < 0 || i >= size()) return QString();
+        return QString::fromUtf8(data.constData() + bounds.at(2 * i), bounds.at(2 * i + 1) - bounds.at(2 * i));
+    }
+    bool isBlank() const { return size() <= 1 && data.trimmed().isEmpty(); }
+};
+
+// 流式 RFC 4180 CSV 解析器
+// 使用固定大小的读缓冲，支持带引号的字段（字段内可含逗号、换行和 "" 转义）、
+// UTF-8 BOM 以及 LF / CRLF / CR 行尾。内存占用只与最长的一行有关，与文件大小无关。
+class CsvReader
+{
+public:
+    explicit CsvReader(QIODevice *in, int bufferSize = 64 * 1024);
+
+    // 读取下一行，文件结束时返回 false
+    bool readRow(CsvRow *row);
+
+    qint64 bytesConsumed() const { return m_consumed; } // 已解析的字节数，用于计算进度
+
+private:
+    bool fill();
+
+    QIODevice *m_in;
+    QByteArray m_buf;
+    int m_pos;
+    int m_len;
+    qint64 m_consumed;
+    qint64 m_line;
+    bool m_atStart;
+    bool m_eof;
+    bool m_skipLf; // 上一行以 CR 结束，下一个 LF 属于同一个行尾
+};
+
+// 写 CSV 时对字段转义：含逗号、引号或换行的字段用双引号包围
+QString csvEscape(const QString &field);
+
+#endif // CSVREADER_H
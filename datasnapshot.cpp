@@ -0,0 +1,162 @@
+#include "datasnapshot.h"
+#include "dbmanager.h"
+#include "metrics.h"
+#include <atomic>
+
+SnapshotStore& SnapshotStore::instance() {
+    static SnapshotStore instance;
+    return instance;
+}
+
+SnapshotStore::SnapshotStore()
+    : m_current(std::make_shared<const DataSnapshot>())
+{
+}
+
+DataSnapshotPtr SnapshotStore::current() const {
+    return std::atomic_load(&m_current);
+}
+
+void SnapshotStore::publish(DataSnapshot *next) {
+    next->version = m_current->version + 1;
+    std::atomic_store(&m_current, DataSnapshotPtr(next));
+    Metrics::count("snapshot_versions_total");
+}
+
+DataSnapshotPtr SnapshotStore::acquire(bool withRecords) {
+    const DataSnapshotPtr snapshot = current();
+    if (snapshot->hasProducts && (snapshot->hasRecords || !withRecords)) return snapshot;
+
+    ScopedTimer timer("snapshot_load");
+    DataSnapshot *next = new DataSnapshot(*snapshot);
+    qint64 rows = 0;
+    if (!next->hasProducts) {
+        const QList<Product> products = DbManager::instance().getAllProducts(); // ID 倒序
+        next->products = ChunkedVector<Product>();
+        next->productIndex.clear();
+        next->productIndex.reserve(products.size());
+        for (int i = products.size() - 1; i >= 0; --i) {
+            next->productIndex.insert(products.at(i).id, next->products.size());
+            next->products.append(products.at(i));
+        }
+        next->hasProducts = true;
+        rows += products.size();
+    }
+    if (withRecords && !next->hasRecords) {
+        const QList<Record> records = DbManager::instance().getAllRecords(); // 时间倒序
+        next->records = ChunkedVector<Record>();
+        for (int i = records.size() - 1; i >= 0; --i) next->records.append(records.at(i));
+        next->hasRecords = true;
+        rows += records.size();
+    }
+    timer.setRows(rows);
+    publish(next);
+    return current();
+}
+
+bool SnapshotStore::adoptProducts(const QList<Product> &products, quint64 generation) {
+    const DataSnapshotPtr snapshot = current();
+    if (generation != m_productGeneration || snapshot->hasProducts) return false;
+
+    ScopedTimer timer("snapshot_adopt_products");
+    timer.setRows(products.size());
+    DataSnapshot *next = new DataSnapshot(*snapshot);
+    next->products = ChunkedVector<Product>();
+    next->productIndex.clear();
+    next->productIndex.reserve(products.size());
+    for (int i = products.size() - 1; i >= 0; --i) {
+        next->productIndex.insert(products.at(i).id, next->products.size());
+        next->products.append(products.at(i));
+    }
+    next->hasProducts = true;
+    publish(next);
+    return true;
+}
+
+void SnapshotStore::onMovements(const QVector<Record> &records, const QHash<int, int> &quantities) {
+    if (!quantities.isEmpty()) ++m_productGeneration;
+    const DataSnapshotPtr snapshot = current();
+    if (!snapshot->hasProducts && !snapshot->hasRecords) return;
+
+    DataSnapshot *next = new DataSnapshot(*snapshot);
+    if (next->hasRecords) {
+        for (const Record &r : records) next->records.append(r);
+    }
+    if (next->hasProducts) {
+        for (auto it = quantities.constBegin(); it != quantities.constEnd(); ++it) {
+            const int row = next->productIndex.value(it.key(), -1);
+            if (row < 0) {
+                next->hasProducts = false; // 不应出现；下次使用时重新加载
+                break;
+            }
+            Product p = next->products.at(row);
+            p.quantity = it.value();
+            next->products.set(row, p);
+        }
+    }
+    publish(next);
+}
+
+void SnapshotStore::onProductSaved(const Product &p) {
+    ++m_productGeneration;
+    const DataSnapshotPtr snapshot = current();
+    if (!snapshot->hasProducts) return;
+
+    DataSnapshot *next = new DataSnapshot(*snapshot);
+    const int row = next->productIndex.value(p.id, -1);
+    if (row >= 0) {
+        next->products.set(row, p);
+    } else if (next->products.size() == 0 || p.id > next->products.at(next->products.size() - 1).id) {
+        //新货品的 ID 最大，追加在末尾即保持升序
+        next->productIndex.insert(p.id, next->products.size());
+        next->products.append(p);
+    } else {
+        next->hasProducts = false;
+    }
+    publish(next);
+}
+
+void SnapshotStore::onProductsUpdated(const QList<Product> &products) {
+    ++m_productGeneration;
+    const DataSnapshotPtr snapshot = current();
+    if (!snapshot->hasProducts) return;
+
+    //整批只发布一个新版本；同一块里的多行只在第一次修改时复制
+    DataSnapshot *next = new DataSnapshot(*snapshot);
+    for (const Product &p : products) {
+        const int row = next->productIndex.value(p.id, -1);
+        if (row < 0) {
+            next->hasProducts = false;
+            break;
+        }
+        Product updated = p;
+        updated.quantity = next->products.at(row).quantity;
+        next->products.set(row, updated);
+    }
+    publish(next);
+}
+
+void SnapshotStore::invalidateProducts() {
+    ++m_productGeneration;
+    const DataSnapshotPtr snapshot = current();
+    if (!snapshot->hasProducts) return;
+    DataSnapshot *next = new DataSnapshot(*snapshot);
+    next->hasProducts = false;
+    next->products = ChunkedVector<Product>();
+    next->productIndex.clear();
+    publish(next);
+}
+
+void SnapshotStore::invalidateRecords() {
+    const DataSnapshotPtr snapshot = current();
+    if (!snapshot->hasRecords) return;
+    DataSnapshot *next = new DataSnapshot(*snapshot);
+    next->hasRecords = false;
+    next->records = ChunkedVector<Record>();
+    publish(next);
+}
+
+void SnapshotStore::invalidate() {
+    ++m_productGeneration;
+    publish(new DataSnapshot());
+}
@@ -0,0 +1,102 @@
+#ifndef DATASNAPSHOT_H
+#define DATASNAPSHOT_H
+
+#include <QVector>
+#include <QHash>
+#include <QList>
+#include <memory>
+#include "warehousedata.h"
+
+// 按块共享的数组：复制时只复制块指针，修改时只复制被改到的那一块（写时复制）
+// 已发布的快照从不修改；只有界面线程在自己的副本上修改，修改前块若还被别的快照引用则先复制
+template <typename T>
+class ChunkedVector
+{
+public:
+    static const int ChunkSize = 4096;
+
+    int size() const { return m_size; }
+    const T &at(int i) const { return m_chunks.at(i / ChunkSize)->at(i % ChunkSize); }
+
+    void append(const T &value) {
+        if (m_size % ChunkSize == 0) {
+            std::shared_ptr<QVector<T>> chunk = std::make_shared<QVector<T>>();
+            chunk->reserve(ChunkSize);
+            m_chunks.append(chunk);
+        }
+        detach(m_chunks.size() - 1)->append(value);
+        m_size++;
+    }
+
+    void set(int i, const T &value) {
+        (*detach(i / ChunkSize))[i % ChunkSize] = value;
+    }
+
+private:
+    QVector<T> *detach(int c) {
+        //先让块指针数组本身脱离共享，use_count 才反映真实的引用数
+        std::shared_ptr<QVector<T>> &chunk = m_chunks[c];
+        if (chunk.use_count() > 1) chunk = std::make_shared<QVector<T>>(*chunk);
+        return chunk.get();
+    }
+
+    QVector<std::shared_ptr<QVector<T>>> m_chunks;
+    int m_size = 0;
+};
+
+// 某一时刻的货品和记录，发布后不再修改，可在任意线程同时读取
+struct DataSnapshot {
+    quint64 version = 0;
+    bool hasProducts = false;         // 货品部分已加载
+    bool hasRecords = false;          // 记录部分已加载
+    ChunkedVector<Product> products;  // 未删除的货品，按 ID 升序
+    QHash<int, int> productIndex;     // 货品ID -> products 下标
+    ChunkedVector<Record> records;    // 按时间升序，新记录追加在末尾
+
+    const Product *product(int id) const {
+        auto it = productIndex.constFind(id);
+        return it == productIndex.constEnd() ? nullptr : &products.at(it.value());
+    }
+};
+
+typedef std::shared_ptr<const DataSnapshot> DataSnapshotPtr;
+
+// 当前快照的持有者：读取方（界面模型、报表、后台导出）拿到一个引用计数的指针，
+// 之后随便读，不加锁也不再查库；写库提交后由 DbManager 在当前快照的副本上改动并原子替换，
+// 版本号加一，正在读旧快照的任务不受影响，导出的就是开始那一刻的数据。
+// 两部分都按需加载：没人用到记录时不会把全部记录读进内存。
+class SnapshotStore
+{
+public:
+    static SnapshotStore& instance();
+
+    DataSnapshotPtr current() const; // 任意线程
+    quint64 version() const { return current()->version; }
+
+    // 以下只在界面线程（写库线程）调用
+    DataSnapshotPtr acquire(bool withRecords); // 需要的部分还没加载时先从数据库读取
+    void onMovements(const QVector<Record> &records, const QHash<int, int> &quantities);
+    void onProductSaved(const Product &p);     // 新增或修改了货品资料
+    void onProductsUpdated(const QList<Product> &products); // 批量修改了货品资料（数量沿用快照中的值）
+    void invalidateProducts();                 // 删除 / 恢复货品后，下次使用时重新加载货品部分
+    void invalidateRecords();                  // 记录被批量改写后
+    void invalidate();                         // 导入、恢复快照后
+
+    // 货品数据的修改代数：以上任何会影响货品的通知都会加一（即使货品部分尚未加载）
+    quint64 productGeneration() const { return m_productGeneration; }
+    // 采用在别处完整读取的货品（ID 倒序，如库存表的后台分页加载）作为货品部分；
+    // 读取开始时记下的代数已经变化（期间有写入）或货品部分已加载时不采用，返回 false
+    bool adoptProducts(const QList<Product> &products, quint64 generation);
+
+private:
+    SnapshotStore();
+    SnapshotStore(const SnapshotStore&) = delete;
+    SnapshotStore& operator=(const SnapshotStore&) = delete;
+
+    void publish(DataSnapshot *next);
+
+    DataSnapshotPtr m_current;
+    quint64 m_productGeneration = 0;
+};
+
+#endif // DATASNAPSHOT_H
@@ -4,9 +4,20 @@
 #include <QSqlError>
 #include <QFile>
 #include <QTextStream>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrent>
 #include <QCoreApplication>
 #include <QDebug>
 #include <QDateTime>
+#include "dbmanager.h"
+#include "metrics.h"
+#include "snapshotfile.h"
+#include "csvreader.h"
+#ifdef WAREHOUSE_SQLITE_API
+#include <sqlite3.h>
+#endif
 
 DataWorker::DataWorker(QObject *parent) : QThread(parent) {}
 
@@ -21,7 +32,7 @@ void DataWorker::run() {
 
     {
         QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connName);
-        db.setDatabaseName(QCoreApplication::applicationDirPath() + "/warehouse.db");
+        db.setDatabaseName(DbManager::databasePath());
 
         if (!db.open()) {
             emit taskFinished(false, "后台线程无法连接数据库");
@@ -38,6 +49,18 @@ void DataWorker::run() {
         case TaskType::ImportStock:
             doImportStock();
             break;
+        case TaskType::ExportSnapshot:
+            doExportSnapshot();
+            break;
+        case TaskType::ImportSnapshot:
+            doImportSnapshot();
+            break;
+        case TaskType::Backup:
+            doBackup();
+            break;
+        case TaskType::Restore:
+            doRestore();
+            break;
         }
 
         db.close();
@@ -47,11 +70,16 @@ void DataWorker::run() {
 
 //导出库存逻辑
 void DataWorker::doExportStock() {
+    ScopedTimer timer("worker_export_stock");
+    if (m_snapshot && m_snapshot->hasProducts) {
+        doExportStockSnapshot();
+        return;
+    }
     QSqlDatabase db = QSqlDatabase::database("WorkerConnection");
     QSqlQuery query(db);
 
     //先查询总数
-    if (!query.exec("SELECT count(*) FROM products")) {
+    if (!query.exec("SELECT count(*) FROM products WHERE deleted = 0")) {
         emit taskFinished(false, "查询失败");
         return;
     }
@@ -76,7 +104,7 @@ void DataWorker::doExportStock() {
     //表头
     out << "ID,编号,名称,分类,单位,单价,库存数量,预警阈值\n";
 
-    if (!query.exec("SELECT * FROM products")) {
+    if (!query.exec("SELECT * FROM products WHERE deleted = 0")) {
         emit taskFinished(false, "查询数据失败");
         return;
     }
@@ -84,10 +112,10 @@ void DataWorker::doExportStock() {
     int current = 0;
     while (query.next()) {
         out << query.value("id").toString() << ","
-            << query.value("code").toString() << ","
-            << query.value("name").toString() << ","
-            << query.value("category").toString() << ","
-            << query.value("unit").toString() << ","
+            << csvEscape(query.value("code").toString()) << ","
+            << csvEscape(query.value("name").toString()) << ","
+            << csvEscape(query.value("category").toString()) << ","
+            << csvEscape(query.value("unit").toString()) << ","
             << query.value("price").toString() << ","
             << query.value("quantity").toString() << ","
             << query.value("min_stock").toString() << "\n";
@@ -97,67 +125,271 @@ void DataWorker::doExportStock() {
         if (current % 10 == 0 || current == total) {
             emit progressUpdated(current, total);
         }
-        //模拟一点耗时，让你能看清进度条（实际项目可去掉）
-        msleep(2);
     }
 
     file.close();
+    timer.setRows(current);
     emit taskFinished(true, QString("成功导出 %1 条库存数据").arg(current));
 }
 
-//导出记录逻辑
-void DataWorker::doExportRecord() {
-    QSqlDatabase db = QSqlDatabase::database("WorkerConnection");
-    QSqlQuery query(db);
-
-    //查询记录总数
-    query.exec("SELECT count(*) FROM records");
-    query.next();
-    int total = query.value(0).toInt();
-
+//从共享快照导出库存：列和顺序与查库导出一致（按 ID 升序）
+void DataWorker::doExportStockSnapshot() {
+    const ChunkedVector<Product> &products = m_snapshot->products;
     QFile file(m_filePath);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        emit taskFinished(false, "无法打开文件");
+        emit taskFinished(false, "无法创建文件");
         return;
     }
 
     QTextStream out(&file);
-    out << QString::fromLocal8Bit("\xEF\xBB\xBF"); // BOM
-    //表头
-    out << "ID,货品ID,类型(1入0出),数量,时间,备注\n";
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    out.setEncoding(QStringConverter::Utf8);
+#else
+    out.setCodec("UTF-8");
+#endif
+    out << QString::fromLocal8Bit("\xEF\xBB\xBF");
+    out << "ID,编号,名称,分类,单位,单价,库存数量,预警阈值\n";
 
-    query.exec("SELECT * FROM records ORDER BY timestamp DESC");
+    const int total = products.size();
+    for (int i = 0; i < total; ++i) {
+        const Product &p = products.at(i);
+        out << p.id << ","
+            << csvEscape(p.code) << ","
+            << csvEscape(p.name) << ","
+            << csvEscape(p.category) << ","
+            << csvEscape(p.unit) << ","
+            << QString::number(p.price, 'g', QLocale::FloatingPointShortest) << ","
+            << p.quantity << ","
+            << p.minStock << "\n";
+        if ((i + 1) % 1000 == 0) emit progressUpdated(i + 1, total);
+    }
 
-    int current = 0;
-    while (query.next()) {
-        QString timeStr = QDateTime::fromSecsSinceEpoch(query.value("timestamp").toLongLong())
-        .toString("yyyy-MM-dd HH:mm:ss");
+    file.close();
+    emit progressUpdated(total, total);
+    emit taskFinished(true, QString("成功导出 %1 条库存数据（数据版本 %2）").arg(total).arg(m_snapshot->version));
+}
 
-        out << query.value("id").toString() << ","
-            << query.value("product_id").toString() << ","
-            << (query.value("type").toInt() == 1 ? "入库" : "出库") << ","
-            << query.value("count").toString() << ","
-            << timeStr << ","
-            << query.value("remark").toString() << "\n";
+//格式化共享快照中下标 [begin, end) 的记录（倒序输出，最新在前），在线程池中运行，不访问数据库
+static QByteArray formatSnapshotShard(DataSnapshotPtr snapshot, int begin, int end, int *rows) {
+    QByteArray out;
+    const QByteArray inbound = QString("入库").toUtf8();
+    const QByteArray outbound = QString("出库").toUtf8();
+    qint64 lastTs = -1;
+    QByteArray timeStr;
+    for (int i = end - 1; i >= begin; --i) {
+        const Record &r = snapshot->records.at(i);
+        const qint64 ts = r.time.toSecsSinceEpoch();
+        if (ts != lastTs) {
+            lastTs = ts;
+            timeStr = r.time.toString("yyyy-MM-dd HH:mm:ss").toUtf8();
+        }
+        out += QByteArray::number(r.id);
+        out += ',';
+        out += QByteArray::number(r.productId);
+        out += ',';
+        out += (r.type == 1) ? inbound : outbound;
+        out += ',';
+        out += QByteArray::number(r.count);
+        out += ',';
+        out += timeStr;
+        out += ',';
+        out += csvEscape(r.remark).toUtf8();
+        out += ',';
+        out += csvEscape(r.productCode).toUtf8();
+        out += ',';
+        out += csvEscape(r.productName).toUtf8();
+        out += '\n';
+    }
+    *rows = end - begin;
+    return out;
+}
 
-        current++;
-        if (current % 10 == 0) emit progressUpdated(current, total);
+//格式化一个时间分片 [fromTs, toTs) 内的记录，在线程池中运行，使用独立的只读连接；
+//withNullTime 时同时包含没有时间的记录（排在最后，放在最早的分片里）。
+//各分片在不同时刻打开连接，只导出 id <= maxId 的记录，导出期间新写入的记录不会出现在部分分片里。
+//连接名带上导出任务的前缀，同时进行的两个导出不会共用连接；打开或查询失败时 *ok 为 false
+static QByteArray formatRecordShard(const QString &connPrefix, int shard, qint64 fromTs, qint64 toTs,
+                                    qint64 maxId, bool withNullTime, int *rows, bool *ok) {
+    const QString connName = QString("%1_%2").arg(connPrefix).arg(shard);
+    QByteArray out;
+    *rows = 0;
+    *ok = false;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connName);
+        db.setDatabaseName(DbManager::databasePath());
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        if (!db.open()) {
+            qDebug() << "Export Shard Open Error:" << shard << db.lastError();
+        } else if (!query.prepare(QString("SELECT id, product_id, type, count, timestamp, remark, product_code, product_name "
+                                          "FROM records "
+                                          "WHERE ((timestamp >= :from AND timestamp < :to)%1) AND id <= :maxId "
+                                          "ORDER BY timestamp DESC, id DESC")
+                                      .arg(withNullTime ? " OR timestamp IS NULL" : ""))) {
+            qDebug() << "Export Shard Query Error:" << shard << query.lastError();
+        } else {
+            query.bindValue(":from", fromTs);
+            query.bindValue(":to", toTs);
+            query.bindValue(":maxId", maxId);
+            *ok = query.exec();
+            if (!*ok) qDebug() << "Export Shard Query Error:" << shard << query.lastError();
+
+            const QByteArray inbound = QString("入库").toUtf8();
+            const QByteArray outbound = QString("出库").toUtf8();
+            qint64 lastTs = -1;
+            QByteArray timeStr;
+            while (query.next()) {
+                //同一秒的记录很常见，时间字符串复用上一次的格式化结果
+                const qint64 ts = query.value(4).toLongLong();
+                if (ts != lastTs) {
+                    lastTs = ts;
+                    timeStr = QDateTime::fromSecsSinceEpoch(ts).toString("yyyy-MM-dd HH:mm:ss").toUtf8();
+                }
+                out += QByteArray::number(query.value(0).toLongLong());
+                out += ',';
+                out += QByteArray::number(query.value(1).toLongLong());
+                out += ',';
+                out += (query.value(2).toInt() == 1) ? inbound : outbound;
+                out += ',';
+                out += QByteArray::number(query.value(3).toLongLong());
+                out += ',';
+                out += timeStr;
+                out += ',';
+                out += csvEscape(query.value(5).toString()).toUtf8();
+                out += ',';
+                out += csvEscape(query.value(6).toString()).toUtf8();
+                out += ',';
+                out += csvEscape(query.value(7).toString()).toUtf8();
+                out += '\n';
+                (*rows)++;
+            }
+            //读取中途出错（如磁盘 I/O 错误）时 next() 同样返回 false
+            if (query.lastError().isValid()) *ok = false;
+            Metrics::count("worker_export_shards_total");
+        }
+        query.clear();
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connName);
+    return out;
+}
+
+//导出记录逻辑：按时间范围分片，多个线程并行格式化，再按时间倒序依次写入文件
+//有共享快照时按下标分片直接格式化快照中的记录，不再查库
+void DataWorker::doExportRecord() {
+    ScopedTimer timer("worker_export_record");
+    const bool fromSnapshot = m_snapshot && m_snapshot->hasRecords;
+    int total = 0;
+    qint64 minTs = 0, maxTs = 0, maxId = 0;
+    if (fromSnapshot) {
+        total = m_snapshot->records.size();
+    } else {
+        //记录总数、时间范围和 id 上限在同一条语句里取得，是同一时刻的数据；
+        //记录只追加不修改，之后各分片按 id 上限过滤，导出的就是这一刻的全部记录
+        QSqlQuery query(QSqlDatabase::database("WorkerConnection"));
+        if (!query.exec("SELECT count(*), min(timestamp), max(timestamp), max(id) FROM records") || !query.next()) {
+            qDebug() << "Export Record Count Error:" << query.lastError();
+            emit taskFinished(false, "读取记录失败");
+            return;
+        }
+        total = query.value(0).toInt();
+        minTs = query.value(1).toLongLong();
+        maxTs = query.value(2).toLongLong();
+        maxId = query.value(3).toLongLong();
+    }
+
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        emit taskFinished(false, "无法打开文件");
+        return;
+    }
+
+    file.write("\xEF\xBB\xBF"); // BOM
+    //表头（货品编号、名称是后加的列，放在最后，原有各列的位置不变）
+    file.write(QString("ID,货品ID,类型(1入0出),数量,时间,备注,货品编号,货品名称\n").toUtf8());
+
+    //按时间范围均匀切分（走 idx_records_timestamp 索引范围扫描；快照按下标切分），
+    //分片数随数据量增加，最多为线程数的 4 倍，保证负载大致均衡
+    const int threads = qMax(1, QThread::idealThreadCount());
+    const int shardCount = qBound(1, total / 50000, threads * 4);
+    const qint64 first = fromSnapshot ? 0 : minTs;
+    const qint64 last = fromSnapshot ? total : maxTs + 1;
+    QVector<qint64> bounds; // 升序边界，分片 i 覆盖 [bounds[i], bounds[i+1])
+    bounds << first;
+    for (int i = 1; i < shardCount; ++i) {
+        const qint64 b = first + (last - first) * i / shardCount;
+        if (b > bounds.last()) bounds << b;
     }
+    bounds << last;
+
+    //从最新的分片开始写；最多同时有 2 * threads 个分片在内存中，控制峰值内存
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    const int shards = bounds.size() - 1;
+    const int window = threads * 2;
+    QVector<QFuture<QByteArray>> futures(shards);
+    QVector<int> shardRows(shards, 0);
+    QVector<bool> shardOk(shards, true);
+    const QString connPrefix = QString("ExportShard%1").arg(quintptr(this), 0, 16);
+
+    auto launch = [&](int k) {
+        const int idx = shards - 1 - k; // 第 k 个写出的分片（时间倒序）
+        int *rows = &shardRows[idx];
+        bool *shardOkPtr = &shardOk[idx];
+        const qint64 from = bounds.at(idx);
+        const qint64 to = bounds.at(idx + 1);
+        if (fromSnapshot)
+            futures[k] = QtConcurrent::run(&pool, formatSnapshotShard, m_snapshot, int(from), int(to), rows);
+        else
+            futures[k] = QtConcurrent::run(&pool, [connPrefix, idx, from, to, maxId, rows, shardOkPtr] {
+                return formatRecordShard(connPrefix, idx, from, to, maxId, idx == 0, rows, shardOkPtr);
+            });
+    };
+    for (int k = 0; k < qMin(window, shards); ++k) launch(k);
+
+    int current = 0;
+    bool ok = true;
+    bool readFailed = false;
+    for (int k = 0; k < shards; ++k) {
+        const QByteArray chunk = futures[k].result();
+        futures[k] = QFuture<QByteArray>();
+        if (k + window < shards) launch(k + window);
+
+        if (!shardOk[shards - 1 - k]) readFailed = true;
+        ok = ok && file.write(chunk) == chunk.size();
+        current += shardRows[shards - 1 - k];
+        emit progressUpdated(current, total);
+    }
+    pool.waitForDone();
 
     emit progressUpdated(total, total);
     file.close();
-    emit taskFinished(true, QString("成功导出 %1 条出入库记录").arg(current));
+    if (readFailed) {
+        file.remove();
+        emit taskFinished(false, "读取记录失败，导出不完整，已删除输出文件");
+        return;
+    }
+    if (!ok) {
+        emit taskFinished(false, "写入文件失败");
+        return;
+    }
+    timer.setRows(current);
+    if (fromSnapshot)
+        emit taskFinished(true, QString("成功导出 %1 条出入库记录（数据版本 %2）").arg(current).arg(m_snapshot->version));
+    else
+        emit taskFinished(true, QString("成功导出 %1 条出入库记录").arg(current));
 }
 
-//导入库存逻辑
+//导入库存逻辑：流式解析，内存占用与文件大小无关；无法导入的行写入 <文件名>.rejected.csv
 void DataWorker::doImportStock() {
+    ScopedTimer timer("worker_import_stock");
     QFile file(m_filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (!file.open(QIODevice::ReadOnly)) {
         emit taskFinished(false, "无法打开导入文件");
         return;
     }
-
-    QTextStream in(&file);
+    const qint64 fileSize = qMax<qint64>(1, file.size());
 
     QSqlDatabase db = QSqlDatabase::database("WorkerConnection");
     db.transaction();
@@ -167,57 +399,548 @@ void DataWorker::doImportStock() {
     query.prepare("INSERT INTO products (code, name, category, unit, price, quantity, min_stock) "
                   "VALUES (:code, :name, :cat, :unit, :price, :qty, :min)");
 
-    int successCount = 0;
-    int lineIndex = 0;
-
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        lineIndex++;
-
-        if (line.isEmpty()) continue;
-        if (lineIndex == 1 && (line.contains("ID") || line.contains("编号"))) continue;
-
-        QStringList parts = line.split(",");
-
+    //编号已存在时给出明确原因；属于已删除货品的编号按导入的资料恢复该货品（原 ID 和历史记录保留），
+    //它原有的分仓库存清掉，导入完成后与新货品一样整体归入默认仓库
+    QSqlQuery lookup(db);
+    lookup.prepare("SELECT id, deleted FROM products WHERE code = :code");
+    QSqlQuery revive(db);
+    revive.prepare("UPDATE products SET name=:name, category=:cat, unit=:unit, price=:price, "
+                   "quantity=:qty, min_stock=:min, deleted=0 WHERE id=:id");
+    QSqlQuery clearLevels(db);
+    clearLevels.prepare("DELETE FROM stock_levels WHERE product_id = :id");
+    int restoredCount = 0;
+
+    //被拒绝的行：保留原文，末尾追加一列原因，修正后可直接重新导入；
+    //上一次导入留下的文件先删掉，本次没有被拒绝的行时不会留下不相干的文件
+    QFile rejectFile(m_filePath + ".rejected.csv");
+    rejectFile.remove();
+    int rejectCount = 0;
+    auto reject = [&](const CsvRow &row, const QString &reason) {
+        if (rejectCount++ == 0 && rejectFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            rejectFile.write("\xEF\xBB\xBF");
+        if (rejectFile.isOpen()) {
+            rejectFile.write(row.raw);
+            rejectFile.write(",");
+            rejectFile.write(csvEscape(QString("第%1行: %2").arg(row.lineNumber).arg(reason)).toUtf8());
+            rejectFile.write("\n");
+        }
+        Metrics::count("worker_import_rows_failed_total");
+    };
 
+    CsvReader reader(&file);
+    CsvRow row;
+    int successCount = 0;
+    bool firstRow = true;
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    qint64 lastReport = 0;
+
+    while (reader.readRow(&row)) {
+        if (row.isBlank()) continue;
+        if (firstRow) {
+            firstRow = false;
+            //与导出的表头逐列比较：编号里含 "ID" 的第一行数据不能被当成表头跳过
+            if (row.field(0).trimmed().compare("ID", Qt::CaseInsensitive) == 0 && row.field(1).trimmed() == "编号")
+                continue;
+        }
 
-        if (parts.size() < 7) continue;
+        //列: ID,编号,名称,分类,单位,单价,库存数量[,预警阈值]
+        if (row.size() < 7) {
+            reject(row, QString("列数不足（%1 列，至少需要 7 列）").arg(row.size()));
+            continue;
+        }
 
+        QString code = row.field(1).trimmed();
+        if (code.isEmpty()) {
+            reject(row, "编号为空");
+            continue;
+        }
 
-        QString code = parts[1].trimmed();
-        QString name = parts[2].trimmed();
-        QString cat  = parts[3].trimmed();
-        QString unit = parts[4].trimmed();
-        double price = parts[5].toDouble();
-        int qty      = parts[6].toInt();
-        int min      = parts[7].toInt();
+        bool okPrice, okQty, okMin = true;
+        double price = row.field(5).trimmed().toDouble(&okPrice);
+        int qty      = row.field(6).trimmed().toInt(&okQty);
+        int min      = row.size() > 7 ? row.field(7).trimmed().toInt(&okMin) : 0;
+        if (!okPrice || !okQty || !okMin) {
+            reject(row, "单价或数量不是有效数字");
+            continue;
+        }
 
-        query.bindValue(":code", code);
-        query.bindValue(":name", name);
-        query.bindValue(":cat", cat);
-        query.bindValue(":unit", unit);
-        query.bindValue(":price", price);
-        query.bindValue(":qty", qty);
-        query.bindValue(":min", min);
+        lookup.bindValue(":code", code);
+        int existingId = -1;
+        bool existingDeleted = false;
+        if (lookup.exec() && lookup.next()) {
+            existingId = lookup.value(0).toInt();
+            existingDeleted = lookup.value(1).toInt() != 0;
+        }
+        lookup.finish();
+        if (existingId != -1 && !existingDeleted) {
+            reject(row, QString("编号 %1 已存在（货品ID %2）").arg(code).arg(existingId));
+            continue;
+        }
 
-        if (query.exec()) {
+        QSqlQuery &write = existingId != -1 ? revive : query;
+        if (existingId != -1) write.bindValue(":id", existingId);
+        else write.bindValue(":code", code);
+        write.bindValue(":name", row.field(2).trimmed());
+        write.bindValue(":cat", row.field(3).trimmed());
+        write.bindValue(":unit", row.field(4).trimmed());
+        write.bindValue(":price", price);
+        write.bindValue(":qty", qty);
+        write.bindValue(":min", min);
+
+        if (existingId != -1) clearLevels.bindValue(":id", existingId);
+        if (write.exec() && (existingId == -1 || clearLevels.exec())) {
             successCount++;
+            if (existingId != -1) restoredCount++;
+        } else {
+            reject(row, write.lastError().isValid() ? write.lastError().text() : clearLevels.lastError().text());
         }
 
-        if (successCount % 50 == 0) {
-            emit progressUpdated(successCount, 0);
+        //按已读字节数报告进度（千分比），约每 200ms 一次
+        const qint64 now = elapsed.elapsed();
+        if (now - lastReport >= 200) {
+            lastReport = now;
+            const qint64 done = reader.bytesConsumed();
+            emit progressUpdated(int(done * 1000 / fileSize), 1000);
+            const qint64 etaSecs = done > 0 ? (fileSize - done) * now / done / 1000 : 0;
+            emit progressMessage(QString("正在导入... 已成功 %1 行，拒绝 %2 行，预计剩余 %3 秒")
+                                     .arg(successCount).arg(rejectCount).arg(etaSecs));
         }
     }
+    emit progressUpdated(1000, 1000);
+    file.close();
+    rejectFile.close();
+
+    QString note;
+    if (restoredCount > 0)
+        note = QString("\n其中 %1 个编号属于已删除的货品，已按导入的资料恢复").arg(restoredCount);
+    if (rejectCount > 0)
+        note += QString("\n%1 行无法导入，已写入: %2").arg(rejectCount).arg(rejectFile.fileName());
 
     //提交事务
+    timer.setRows(successCount);
     if (db.commit()) {
-        file.close();
-        emit taskFinished(true, QString("批量导入完成，成功插入 %1 个货品").arg(successCount));
+        emit taskFinished(true, QString("批量导入完成，成功插入 %1 个货品").arg(successCount) + note);
     } else {
         db.rollback();
-        file.close();
         emit taskFinished(false, "数据库提交事务失败，导入回滚");
     }
 }
 
+//快照中各表的列定义（列顺序即写入顺序）
+static QList<SnapshotColumn> snapshotColumns(const QString &table) {
+    if (table == "products") {
+        return {{"id", SnapshotType::Int64}, {"code", SnapshotType::String},
+                {"name", SnapshotType::String}, {"category", SnapshotType::String},
+                {"unit", SnapshotType::String}, {"price", SnapshotType::Float64},
+                {"quantity", SnapshotType::Int64}, {"min_stock", SnapshotType::Int64},
+                {"deleted", SnapshotType::Int64}};
+    }
+    if (table == "records") {
+        return {{"id", SnapshotType::Int64}, {"product_id", SnapshotType::Int64},
+                {"type", SnapshotType::Int64}, {"count", SnapshotType::Int64},
+                {"timestamp", SnapshotType::Int64}, {"remark", SnapshotType::String},
+                {"location_id", SnapshotType::Int64}, {"peer_location_id", SnapshotType::Int64},
+                {"request_key", SnapshotType::String}, {"product_code", SnapshotType::String},
+                {"product_name", SnapshotType::String}};
+    }
+    if (table == "locations") {
+        return {{"id", SnapshotType::Int64}, {"code", SnapshotType::String},
+                {"name", SnapshotType::String}};
+    }
+    if (table == "stock_levels") {
+        return {{"product_id", SnapshotType::Int64}, {"location_id", SnapshotType::Int64},
+                {"quantity", SnapshotType::Int64}};
+    }
+    return {};
+}
 
+//导出二进制快照
+void DataWorker::doExportSnapshot() {
+    ScopedTimer timer("worker_export_snapshot");
+    QSqlDatabase db = QSqlDatabase::database("WorkerConnection");
+    QSqlQuery query(db);
+    const QStringList tables = {"locations", "products", "stock_levels", "records"};
+
+    //总行数用于进度
+    int total = 0;
+    for (const QString &table : tables) {
+        if (query.exec("SELECT count(*) FROM " + table) && query.next())
+            total += query.value(0).toInt();
+    }
+
+    QFile file(m_filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        emit taskFinished(false, "无法创建文件");
+        return;
+    }
+
+    //整个导出在一个读事务里完成，保证货品和记录是同一时刻的状态
+    db.transaction();
+
+    SnapshotWriter writer(&file, m_compress);
+    bool ok = writer.writeHeader(tables.size());
+    int current = 0;
+
+    for (const QString &table : tables) {
+        if (!ok) break;
+        const QList<SnapshotColumn> columns = snapshotColumns(table);
+        QStringList names;
+        for (const SnapshotColumn &c : columns) names << c.name;
+
+        ok = writer.beginTable(table, columns)
+             && query.exec(QString("SELECT %1 FROM %2 ORDER BY %3").arg(names.join(", "), table, names.first()));
+
+        QVariantList row;
+        row.reserve(columns.size());
+        while (ok && query.next()) {
+            row.clear();
+            for (int i = 0; i < columns.size(); ++i) row << query.value(i);
+            ok = writer.appendRow(row);
+
+            current++;
+            if (current % 10000 == 0) emit progressUpdated(current, total);
+        }
+        ok = ok && writer.endTable();
+    }
+    ok = ok && writer.finish();
+    db.commit();
+    file.close();
+
+    if (!ok) {
+        QString error = writer.errorString().isEmpty() ? query.lastError().text() : writer.errorString();
+        file.remove();
+        emit taskFinished(false, "导出快照失败: " + error);
+        return;
+    }
+
+    timer.setRows(current);
+    emit progressUpdated(total, total);
+    emit taskFinished(true, QString("成功导出快照，共 %1 行，文件大小 %2 KB")
+                                .arg(current).arg(QFileInfo(m_filePath).size() / 1024));
+}
+
+//从二进制快照恢复：在一个事务中清空并重建货品表和记录表
+void DataWorker::doImportSnapshot() {
+    ScopedTimer timer("worker_import_snapshot");
+    SnapshotReader reader;
+    if (!reader.open(m_filePath)) {
+        emit taskFinished(false, reader.errorString());
+        return;
+    }
+
+    QSqlDatabase db = QSqlDatabase::database("WorkerConnection");
+    db.transaction();
+    QSqlQuery query(db);
+    //全文索引的触发器逐行维护太慢，整表替换期间先去掉，导入完成后一次性重建；
+    //旧的库存检查点与恢复后的记录不再对应，恢复完成后会重新创建。
+    //清空任何一张表失败都中止，否则会与残留的数据主键冲突或混在一起
+    QString error;
+    if (!DbManager::setFullTextTriggers(db, false)) error = "无法暂停全文索引";
+    for (const char *sql : {"DELETE FROM records", "DELETE FROM stock_levels", "DELETE FROM products",
+                            "DELETE FROM locations", "DELETE FROM checkpoint_stock", "DELETE FROM checkpoints"}) {
+        if (!error.isEmpty()) break;
+        if (!query.exec(sql)) error = query.lastError().text();
+    }
+
+    QString table;
+    QList<SnapshotColumn> columns;
+    QVector<SnapshotColumnData> block;
+    int rows = 0;
+    int imported = 0;
+
+    while (error.isEmpty() && reader.nextTable(&table, &columns)) {
+        //只接受已知的表和列，拼接进 SQL 的名称不能直接来自文件
+        const QList<SnapshotColumn> known = snapshotColumns(table);
+        QStringList names, placeholders;
+        for (const SnapshotColumn &c : columns) {
+            bool found = false;
+            for (const SnapshotColumn &k : known)
+                found = found || (k.name == c.name && k.type == c.type);
+            if (!found) {
+                error = QString("快照中存在未知的表或列: %1.%2").arg(table, c.name);
+                break;
+            }
+            names << c.name;
+            placeholders << "?";
+        }
+        const int requestKeyColumn = names.indexOf("request_key");
+        if (!error.isEmpty()) break;
+
+        if (!query.prepare(QString("INSERT INTO %1 (%2) VALUES (%3)")
+                               .arg(table, names.join(", "), placeholders.join(", ")))) {
+            error = query.lastError().text();
+            break;
+        }
+
+        while (error.isEmpty() && reader.nextBlock(&block, &rows)) {
+            for (int r = 0; r < rows; ++r) {
+                for (int c = 0; c < columns.size(); ++c) {
+                    QVariant v = block.at(c).value(columns.at(c).type, r);
+                    //快照里的空字符串还原成 NULL，否则会违反幂等键的唯一索引
+                    if (c == requestKeyColumn && v.toString().isEmpty()) v = QVariant();
+                    query.bindValue(c, v);
+                }
+                if (!query.exec()) {
+                    error = query.lastError().text();
+                    break;
+                }
+                imported++;
+            }
+            emit progressUpdated(int(reader.position() * 1000 / reader.size()), 1000);
+        }
+        //表尾行数与读到的不符
+        if (error.isEmpty()) error = reader.errorString();
+    }
+    //表数量与文件头不符，或文件被截断
+    if (error.isEmpty()) error = reader.errorString();
+    if (error.isEmpty() && !(DbManager::setFullTextTriggers(db, true) && DbManager::rebuildFullText(db)))
+        error = "重建全文索引失败";
+
+    if (error.isEmpty() && db.commit()) {
+        timer.setRows(imported);
+        emit progressUpdated(1000, 1000);
+        emit taskFinished(true, QString("快照恢复完成，共导入 %1 行").arg(imported));
+    } else {
+        db.rollback();
+        emit taskFinished(false, "快照恢复失败，已回滚: " + (error.isEmpty() ? "事务提交失败" : error));
+    }
+}
+
+//压缩备份文件：魔数 + 版本 + 若干块（原始长度 + 压缩长度 + qCompress 数据），0 长度块结尾
+//按块流式处理，数据库再大也只占用一块的内存
+static const quint32 BackupMagic = 0x57484b42; // "WHKB"
+static const quint16 BackupVersion = 1;
+static const int BackupBlockSize = 4 * 1024 * 1024;
+
+static bool compressFile(const QString &from, const QString &to, QString *error) {
+    QFile in(from), out(to);
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = "无法打开备份文件";
+        return false;
+    }
+    QDataStream stream(&out);
+    stream << BackupMagic << BackupVersion;
+    while (!in.atEnd()) {
+        const QByteArray raw = in.read(BackupBlockSize);
+        const QByteArray packed = qCompress(raw, 6);
+        stream << quint32(raw.size()) << quint32(packed.size());
+        stream.writeRawData(packed.constData(), packed.size());
+    }
+    stream << quint32(0) << quint32(0);
+    if (stream.status() != QDataStream::Ok || in.error() != QFile::NoError) {
+        *error = "写入备份文件失败";
+        return false;
+    }
+    return true;
+}
+
+static bool decompressFile(const QString &from, const QString &to, QString *error) {
+    QFile in(from), out(to);
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *error = "无法打开备份文件";
+        return false;
+    }
+    QDataStream stream(&in);
+    quint32 magic = 0;
+    quint16 version = 0;
+    stream >> magic >> version;
+    if (magic != BackupMagic || version != BackupVersion) {
+        *error = "不是有效的压缩备份文件";
+        return false;
+    }
+    for (;;) {
+        quint32 rawSize = 0, packedSize = 0;
+        stream >> rawSize >> packedSize;
+        if (stream.status() != QDataStream::Ok || packedSize > quint32(BackupBlockSize) * 2) {
+            *error = "备份文件已损坏";
+            return false;
+        }
+        if (rawSize == 0) break;
+        QByteArray packed(int(packedSize), Qt::Uninitialized);
+        if (stream.readRawData(packed.data(), packed.size()) != packed.size()) {
+            *error = "备份文件不完整";
+            return false;
+        }
+        const QByteArray raw = qUncompress(packed);
+        if (raw.size() != int(rawSize) || out.write(raw) != raw.size()) {
+            *error = "备份文件已损坏";
+            return false;
+        }
+    }
+    return true;
+}
+
+//逐表快速检查（PRAGMA quick_check(表名)），每张表一个短的读事务，可以报告进度；
+//不支持按表检查的旧版本 SQLite 退回整库检查
+bool DataWorker::quickCheck(const QString &path, QString *error) {
+    const QString connName = "BackupCheck";
+    bool ok = true;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connName);
+        db.setDatabaseName(path);
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        if (!db.open()) {
+            *error = "无法打开备份进行检查";
+            ok = false;
+        }
+        QSqlQuery query(db);
+        QStringList tables;
+        if (ok && query.exec("SELECT name FROM sqlite_master WHERE type = 'table' AND sql NOT LIKE 'CREATE VIRTUAL%'")) {
+            while (query.next()) tables << query.value(0).toString();
+        }
+        if (ok && (!tables.contains("products") || !tables.contains("records"))) {
+            *error = "不是仓库数据库";
+            ok = false;
+        }
+        //更新版本的程序做的备份：结构无法降级，不能恢复
+        if (ok && query.exec("PRAGMA user_version") && query.next()
+            && query.value(0).toInt() > DbManager::SchemaVersion) {
+            *error = "备份来自更新版本的程序";
+            ok = false;
+        }
+
+        auto check = [&](const QString &sql) {
+            if (!query.exec(sql)) return false;
+            while (query.next()) {
+                const QString result = query.value(0).toString();
+                if (result != "ok") {
+                    *error = "完整性检查未通过: " + result;
+                    ok = false;
+                    break;
+                }
+            }
+            return true;
+        };
+        for (int i = 0; ok && i < tables.size(); ++i) {
+            emit progressMessage(QString("正在检查 %1 (%2/%3)...").arg(tables.at(i)).arg(i + 1).arg(tables.size()));
+            if (!check(QString("PRAGMA quick_check(\"%1\")").arg(tables.at(i)))) {
+                if (!check("PRAGMA quick_check")) {
+                    *error = query.lastError().text();
+                    ok = false;
+                }
+                break;
+            }
+            emit progressUpdated(i + 1, tables.size());
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connName);
+    return ok;
+}
+
+#ifdef WAREHOUSE_SQLITE_API
+//用本程序链接的 SQLite 备份 API 分步复制：两边的连接都由这里自己打开，不使用 Qt 驱动内部的句柄。
+//每步复制若干页，步与步之间让出主库，界面的出入库最多等一步；其他连接写入主库会让备份从头开始，
+//重来次数过多时剩下的部分一次复制完
+static const int BackupPagesPerStep = 256;
+static const int BackupPauseMs = 5;
+static const int BackupMaxRestarts = 20;
+
+bool DataWorker::copyDatabase(const QString &target, QString *error) {
+    sqlite3 *src = nullptr;
+    sqlite3 *dest = nullptr;
+    int rc = sqlite3_open_v2(DbManager::databasePath().toUtf8().constData(), &src, SQLITE_OPEN_READONLY, nullptr);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_open_v2(target.toUtf8().constData(), &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+    sqlite3_backup *backup = rc == SQLITE_OK ? sqlite3_backup_init(dest, "main", src, "main") : nullptr;
+    if (!backup) {
+        *error = QString::fromUtf8(sqlite3_errmsg(dest ? dest : src));
+        sqlite3_close(dest);
+        sqlite3_close(src);
+        return false;
+    }
+    sqlite3_busy_timeout(src, 5000);
+
+    int steps = 0;
+    int restarts = 0;
+    int lastRemaining = -1;
+    do {
+        if (isInterruptionRequested()) {
+            rc = SQLITE_INTERRUPT;
+            break;
+        }
+        rc = sqlite3_backup_step(backup, restarts < BackupMaxRestarts ? BackupPagesPerStep : -1);
+        steps++;
+        const int total = sqlite3_backup_pagecount(backup);
+        const int remaining = sqlite3_backup_remaining(backup);
+        if (lastRemaining >= 0 && remaining > lastRemaining) restarts++;
+        lastRemaining = remaining;
+        if (total > 0) emit progressUpdated(total - remaining, total);
+        if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED) QThread::msleep(BackupPauseMs);
+    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+    sqlite3_backup_finish(backup);
+    sqlite3_close(dest);
+    sqlite3_close(src);
+
+    Metrics::count("backup_steps_total", steps);
+    Metrics::count("backup_restarts_total", restarts);
+    if (rc == SQLITE_DONE) return true;
+    *error = rc == SQLITE_INTERRUPT ? QString("已取消") : QString::fromUtf8(sqlite3_errstr(rc));
+    return false;
+}
+#else
+//没有系统 SQLite 开发文件时：在本线程的连接上用 VACUUM INTO 一次复制出一致的副本
+//（SQLite 3.27 起支持），复制期间不显示进度，也不能取消
+bool DataWorker::copyDatabase(const QString &target, QString *error) {
+    emit progressUpdated(0, 0);
+    QSqlQuery query(QSqlDatabase::database("WorkerConnection"));
+    query.prepare("VACUUM INTO :target");
+    query.bindValue(":target", target);
+    if (query.exec()) return true;
+    *error = query.lastError().text();
+    return false;
+}
+#endif
+
+//在线备份：复制出副本并做快速检查，.whbk 再压缩；备份期间界面照常出入库
+void DataWorker::doBackup() {
+    ScopedTimer timer("worker_backup");
+    QString error;
+    const bool compress = m_filePath.endsWith(".whbk", Qt::CaseInsensitive);
+    const QString copyPath = compress ? m_filePath + ".tmp" : m_filePath;
+    QFile::remove(copyPath);
+    emit progressMessage("正在复制数据库...");
+    if (copyDatabase(copyPath, &error)) quickCheck(copyPath, &error);
+    if (error.isEmpty() && compress) {
+        emit progressMessage("正在压缩备份...");
+        compressFile(copyPath, m_filePath, &error);
+    }
+    if (compress) QFile::remove(copyPath);
+    if (!error.isEmpty()) {
+        QFile::remove(m_filePath);
+        emit taskFinished(false, "备份失败: " + error);
+        return;
+    }
+    timer.setRows(QFileInfo(m_filePath).size());
+    emit taskFinished(true, QString("备份完成，文件大小 %1 KB").arg(QFileInfo(m_filePath).size() / 1024));
+}
+
+QString DataWorker::restoreStagingPath() {
+    return DbManager::databasePath() + ".restore";
+}
+
+//恢复的准备部分：解压（或复制）到临时文件并检查，主库此时还没有改动；
+//覆盖主库需要使用主连接，由界面线程在任务结束后进行
+void DataWorker::doRestore() {
+    ScopedTimer timer("worker_restore");
+    QString error;
+    const QString staging = restoreStagingPath();
+    QFile::remove(staging);
+    if (m_filePath.endsWith(".whbk", Qt::CaseInsensitive)) {
+        emit progressMessage("正在解压备份...");
+        decompressFile(m_filePath, staging, &error);
+    } else if (!QFile::copy(m_filePath, staging)) {
+        error = "无法读取备份文件";
+    }
+    if (error.isEmpty()) quickCheck(staging, &error);
+
+    if (!error.isEmpty()) {
+        QFile::remove(staging);
+        emit taskFinished(false, "恢复失败，当前数据未改动: " + error);
+        return;
+    }
+    timer.setRows(QFileInfo(staging).size());
+    emit taskFinished(true, "已从备份恢复数据库");
+}
@@ -3,12 +3,17 @@
 
 #include <QThread>
 #include <QString>
+#include "datasnapshot.h"
 
 // 定义任务类型
 enum class TaskType {
     ExportStock,   // 导出库存
     ExportRecord,  // 导出记录
-    ImportStock    // 导入库存
+    ImportStock,   // 导入库存
+    ExportSnapshot,// 导出二进制快照（货品 + 记录）
+    ImportSnapshot,// 从二进制快照恢复
+    Backup,        // 在线备份：复制数据库并检查副本，.whbk 再压缩
+    Restore        // 解压并检查备份，准备好用于恢复的副本（覆盖主库见 DbManager::restoreFrom）
 };
 
 class DataWorker : public QThread
@@ -19,6 +24,14 @@ public:
 
     // 设置任务参数
     void setTask(TaskType type, const QString &filePath);
+    TaskType taskType() const { return m_type; }
+    // 导出快照时是否压缩
+    void setCompression(bool on) { m_compress = on; }
+    // 导出库存 / 记录时使用的共享快照（在界面线程取得，导出的就是这一刻的数据）；
+    // 不设置或需要的部分没有加载时仍从数据库读取
+    void setSnapshot(const DataSnapshotPtr &snapshot) { m_snapshot = snapshot; }
+    // 恢复：检查通过的副本放在这里，由界面线程覆盖主库后删除
+    static QString restoreStagingPath();
 
 protected:
     void run() override; // 线程入口函数
@@ -26,17 +39,28 @@ protected:
 signals:
     // 报告进度 (current / total)
     void progressUpdated(int current, int total);
+    // 进度说明文字（如预计剩余时间）
+    void progressMessage(QString message);
     // 任务结束 (成功/失败，以及消息)
     void taskFinished(bool success, QString message);
 
 private:
     TaskType m_type;
     QString m_filePath;
+    bool m_compress = false;
+    DataSnapshotPtr m_snapshot;
 
     // 内部处理函数
     void doExportStock();
+    void doExportStockSnapshot();
     void doExportRecord();
     void doImportStock();
+    void doExportSnapshot();
+    void doImportSnapshot();
+    void doBackup();
+    void doRestore();
+    bool copyDatabase(const QString &target, QString *error);
+    bool quickCheck(const QString &path, QString *error);
 };
 
 #endif // DATAWORKER_H
@@ -1,11 +1,24 @@
 #include "dbmanager.h"
+#include "metrics.h"
+#include "lowstockmonitor.h"
+#include "forecaster.h"
+#include "reportengine.h"
+#include "locationstock.h"
+#include "requestkeyfilter.h"
+#include "datasnapshot.h"
 #include <QSqlQuery>
 #include <QSqlError>
+#include <QSqlDriver>
+#include <QVector>
+#include <QSet>
 #include <QDebug>
 #include <QCoreApplication>
 #include <QStandardPaths>
+#include <QtConcurrent>
 
-DbManager::DbManager() {}
+QString DbManager::s_dbPath;
+
+DbManager::DbManager() : m_fullText(false), m_fullTextTrigram(false) {}
 
 DbManager::~DbManager() {
     if (m_db.isOpen()) m_db.close();
@@ -16,16 +29,140 @@ DbManager& DbManager::instance() {
     return instance;
 }
 
-bool DbManager::init() {
+QString DbManager::databasePath() {
+    if (s_dbPath.isEmpty())
+        return QCoreApplication::applicationDirPath() + "/warehouse.db";
+    return s_dbPath;
+}
+
+//用已检查过的数据库文件覆盖主库：在主连接上 ATTACH 副本，一个事务内删掉现有的表，按副本中的
+//建表语句重建并复制数据，失败时整体回滚、主库不变。全程只经过 Qt 驱动里的 SQLite，
+//不把句柄交给另一份 SQLite 库。调用方在此期间阻塞界面
+bool DbManager::restoreFrom(const QString &path, QString *error) {
+    ScopedTimer timer("db_restore_from");
+    //后台还在建全文索引时先等它结束，否则它会在替换后的库上再建一遍
+    m_fullTextBuild.waitForFinished();
+    QSqlQuery query(m_db);
+    query.prepare("ATTACH DATABASE :path AS restore_src");
+    query.bindValue(":path", path);
+    if (!query.exec()) {
+        *error = "无法打开备份文件: " + query.lastError().text();
+        return false;
+    }
+
+    m_db.transaction();
+    const bool ok = replaceSchemaFrom("restore_src", &query) && m_db.commit();
+    if (ok) {
+        Metrics::count("db_commits_total");
+    } else {
+        *error = "覆盖数据库失败，当前数据未改动: " + query.lastError().text();
+        m_db.rollback();
+        Metrics::count("db_rollbacks_total");
+    }
+    query.exec("DETACH DATABASE restore_src");
+    if (!ok) return false;
+
+    //旧版本的备份缺少新列，全文索引没有复制，按启动时的流程补齐
+    if (!initSchema()) {
+        *error = "数据已被备份覆盖，但升级数据库结构失败";
+        return false;
+    }
+    return true;
+}
+
+//在当前事务中把 main 换成 source 中的表、索引和数据，并带上 user_version（之后 initSchema 据此升级）。
+//全文索引（虚表及其影子表）和它的触发器不复制：备份可能来自不支持其分词器的 SQLite，由 initSchema 重建
+bool DbManager::replaceSchemaFrom(const QString &source, QSqlQuery *query) {
+    //先删触发器和全文虚表（影子表随之删除），再删其余的表（索引随表删除）
+    QStringList triggers, virtualDrops, tableDrops;
+    if (!query->exec("SELECT type, name, sql FROM main.sqlite_master "
+                     "WHERE type IN ('trigger', 'table') AND name NOT LIKE 'sqlite_%'"))
+        return false;
+    while (query->next()) {
+        const QString name = query->value(1).toString();
+        if (query->value(0).toString() == "trigger") triggers << QString("DROP TRIGGER IF EXISTS \"%1\"").arg(name);
+        else if (query->value(2).toString().startsWith("CREATE VIRTUAL")) virtualDrops << QString("DROP TABLE IF EXISTS \"%1\"").arg(name);
+        else tableDrops << QString("DROP TABLE IF EXISTS \"%1\"").arg(name);
+    }
+    for (const QString &sql : triggers + virtualDrops + tableDrops) {
+        if (!query->exec(sql)) return false;
+    }
+
+    //副本中的表：跳过虚表和以 "<虚表名>_" 开头的影子表
+    struct Table { QString name; QString sql; };
+    QList<Table> tables;
+    QStringList virtualTables;
+    if (!query->exec(QString("SELECT name, sql FROM %1.sqlite_master "
+                             "WHERE type = 'table' AND name NOT LIKE 'sqlite_%'").arg(source)))
+        return false;
+    while (query->next()) {
+        const QString sql = query->value(1).toString();
+        if (sql.startsWith("CREATE VIRTUAL")) virtualTables << query->value(0).toString();
+        else tables.append({query->value(0).toString(), sql});
+    }
+    auto copied = [&virtualTables](const QString &table) {
+        for (const QString &v : virtualTables) {
+            if (table == v || table.startsWith(v + "_")) return false;
+        }
+        return true;
+    };
+    bool hasSequence = false;
+    for (const Table &t : tables) {
+        if (!copied(t.name)) continue;
+        if (!query->exec(t.sql)
+            || !query->exec(QString("INSERT INTO main.\"%1\" SELECT * FROM %2.\"%1\"").arg(t.name, source)))
+            return false;
+        hasSequence = hasSequence || t.sql.contains("AUTOINCREMENT", Qt::CaseInsensitive);
+    }
+    //自增序号：否则新插入的行可能重用备份里已删除行的ID
+    if (hasSequence && (!query->exec("DELETE FROM main.sqlite_sequence")
+                        || !query->exec(QString("INSERT INTO main.sqlite_sequence SELECT * FROM %1.sqlite_sequence").arg(source))))
+        return false;
+
+    //索引（sql 为空的是约束自动建立的索引，建表时已经有了）
+    QStringList indexes;
+    if (!query->exec(QString("SELECT tbl_name, sql FROM %1.sqlite_master "
+                             "WHERE type = 'index' AND sql IS NOT NULL").arg(source)))
+        return false;
+    while (query->next()) {
+        if (copied(query->value(0).toString())) indexes << query->value(1).toString();
+    }
+    for (const QString &sql : indexes) {
+        if (!query->exec(sql)) return false;
+    }
+
+    if (!query->exec(QString("PRAGMA %1.user_version").arg(source)) || !query->next()) return false;
+    return query->exec(QString("PRAGMA main.user_version = %1").arg(query->value(0).toInt()));
+}
+
+//旧数据库升级：表中没有该列时追加
+static bool ensureColumn(const QString &table, const QString &column, const QString &definition) {
+    QSqlQuery query;
+    query.exec(QString("PRAGMA table_info(%1)").arg(table));
+    while (query.next()) {
+        if (query.value(1).toString() == column) return true;
+    }
+    if (!query.exec(QString("ALTER TABLE %1 ADD COLUMN %2 %3").arg(table, column, definition))) {
+        qDebug() << "Add Column Error:" << table << column << query.lastError();
+        return false;
+    }
+    return true;
+}
+
+bool DbManager::init(const QString &dbPath) {
+    s_dbPath = dbPath;
     m_db = QSqlDatabase::addDatabase("QSQLITE");
-    QString dbPath = QCoreApplication::applicationDirPath() + "/warehouse.db";
-    m_db.setDatabaseName(dbPath);
+    m_db.setDatabaseName(databasePath());
 
     if (!m_db.open()) {
         qDebug() << "DB Connect Error:" << m_db.lastError().text();
         return false;
     }
+    return initSchema();
+}
 
+//建表和版本升级；启动时和从备份恢复之后执行（备份可能来自旧版本或另一个 SQLite）
+bool DbManager::initSchema() {
     QSqlQuery query;
 
     //创建货品表
@@ -37,8 +174,10 @@ bool DbManager::init() {
                          "unit TEXT, "
                          "price REAL, "
                          "quantity INTEGER DEFAULT 0, "
-                         "min_stock INTEGER DEFAULT 0)");
+                         "min_stock INTEGER DEFAULT 0, "
+                         "deleted INTEGER DEFAULT 0)");
     if (!t1) qDebug() << "Create Products Table Error:" << query.lastError();
+    t1 = t1 && ensureColumn("products", "deleted", "INTEGER DEFAULT 0");
 
     //创建记录表
     bool t2 = query.exec("CREATE TABLE IF NOT EXISTS records ("
@@ -47,15 +186,89 @@ bool DbManager::init() {
                          "type INTEGER, "
                          "count INTEGER, "
                          "timestamp INTEGER, "
-                         "remark TEXT)");
+                         "remark TEXT, "
+                         "location_id INTEGER DEFAULT 1, "
+                         "peer_location_id INTEGER DEFAULT 0, "
+                         "request_key TEXT, "
+                         "product_code TEXT, "
+                         "product_name TEXT)");
     if (!t2) qDebug() << "Create Records Table Error:" << query.lastError();
+    //location_id: 发生变动的仓库；peer_location_id: 调拨时的对方仓库，普通出入库为 0
+    t2 = t2 && ensureColumn("records", "location_id", "INTEGER DEFAULT 1")
+         && ensureColumn("records", "peer_location_id", "INTEGER DEFAULT 0")
+         && ensureColumn("records", "request_key", "TEXT")
+         && ensureColumn("records", "product_code", "TEXT")
+         && ensureColumn("records", "product_name", "TEXT");
+
+    //幂等键：只有带键的记录进入索引，唯一约束兜底防止重复记账
+    if (!query.exec("CREATE UNIQUE INDEX IF NOT EXISTS idx_records_request_key ON records(request_key) "
+                    "WHERE request_key IS NOT NULL"))
+        qDebug() << "Create Request Key Index Error:" << query.lastError();
+
+    //按时间排序/分片导出时使用
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_records_timestamp ON records(timestamp)"))
+        qDebug() << "Create Records Index Error:" << query.lastError();
+    //单个货品的流水按时间分页
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_records_pid_ts ON records(product_id, timestamp, id)"))
+        qDebug() << "Create Product Records Index Error:" << query.lastError();
+
+    //部分索引：只包含低于安全库存的货品，低库存列表不再需要全表扫描
+    if (!query.exec("CREATE INDEX IF NOT EXISTS idx_products_low_stock ON products(id) "
+                    "WHERE quantity < min_stock"))
+        qDebug() << "Create Low Stock Index Error:" << query.lastError();
+
+    //库存检查点：checkpoints 记录时间和当时最后一条记录的 ID，checkpoint_stock 保存各货品数量
+    bool t3 = query.exec("CREATE TABLE IF NOT EXISTS checkpoints ("
+                         "ts INTEGER PRIMARY KEY, "
+                         "last_record_id INTEGER)")
+              && query.exec("CREATE TABLE IF NOT EXISTS checkpoint_stock ("
+                            "ts INTEGER, "
+                            "product_id INTEGER, "
+                            "quantity INTEGER, "
+                            "PRIMARY KEY (ts, product_id)) WITHOUT ROWID");
+    if (!t3) qDebug() << "Create Checkpoint Tables Error:" << query.lastError();
+
+    //分仓库存：每个 (货品, 仓库) 一行，不同仓库的出入库只改各自的行；
+    //products.quantity 保留为各仓库之和，在同一事务中维护，原有的查询和报表不受影响
+    bool t4 = query.exec("CREATE TABLE IF NOT EXISTS locations ("
+                         "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+                         "code TEXT UNIQUE, "
+                         "name TEXT)")
+              && query.exec("CREATE TABLE IF NOT EXISTS stock_levels ("
+                            "product_id INTEGER, "
+                            "location_id INTEGER, "
+                            "quantity INTEGER DEFAULT 0, "
+                            "PRIMARY KEY (product_id, location_id)) WITHOUT ROWID");
+    if (!t4) qDebug() << "Create Location Tables Error:" << query.lastError();
+
+    //早期版本写过货品操作日志，从来不读，也没有清理；撤销只用内存中的撤销栈，旧表直接去掉
+    bool t5 = query.exec("DROP TABLE IF EXISTS operation_log");
+    if (!t5) qDebug() << "Drop Operation Log Error:" << query.lastError();
 
-    return t1 && t2;
+    //数据库版本：只在首次建库或从旧版本升级时整理分仓库存，避免每次启动都扫描全部货品
+    int version = 0;
+    if (query.exec("PRAGMA user_version") && query.next()) version = query.value(0).toInt();
+    if (t4 && version < 1) {
+        t4 = reconcileStockLevels() && query.exec("PRAGMA user_version = 1");
+        if (t4) version = 1;
+    }
+    //版本 2：记录中冗余保存货品编号和名称，升级时给已有记录补上
+    if (t2 && version < 2) {
+        t2 = backfillRecordProducts() && query.exec(QString("PRAGMA user_version = %1").arg(SchemaVersion));
+    }
+
+    //全文索引不是必需的：SQLite 没有编译 FTS5 时搜索退回 LIKE 扫描，其余功能不受影响
+    m_fullTextTrigram = false;
+    m_fullText = ensureFullTextIndex();
+
+    return t1 && t2 && t3 && t4 && t5;
 }
 
-//货品管理实现
+//货品管理实现：新增货品时货品行和分仓库存行在同一个事务中写入
 
-bool DbManager::addProduct(const Product &p) {
+bool DbManager::addProduct(const Product &p, int *newId) {
+    ScopedTimer timer("db_add_product");
+    m_db.transaction();
     QSqlQuery query;
     query.prepare("INSERT INTO products (code, name, category, unit, price, quantity, min_stock) "
                   "VALUES (:code, :name, :cat, :unit, :price, :qty, :min)");
@@ -66,10 +279,45 @@ bool DbManager::addProduct(const Product &p) {
     query.bindValue(":price", p.price);
     query.bindValue(":qty", p.quantity);
     query.bindValue(":min", p.minStock);
-    return query.exec();
+    if (!query.exec()) {
+        m_db.rollback();
+        Metrics::count("db_rollbacks_total");
+        return false;
+    }
+    const int id = query.lastInsertId().toInt();
+
+    //初始库存记在默认仓库
+    query.prepare("INSERT INTO stock_levels (product_id, location_id, quantity) VALUES (:pid, :loc, :qty)");
+    query.bindValue(":pid", id);
+    query.bindValue(":loc", DefaultLocationId);
+    query.bindValue(":qty", p.quantity);
+    if (!query.exec()) {
+        qDebug() << "Insert Stock Level Error:" << query.lastError();
+        m_db.rollback();
+        Metrics::count("db_rollbacks_total");
+        return false;
+    }
+
+    if (!m_db.commit()) {
+        m_db.rollback();
+        Metrics::count("db_rollbacks_total");
+        return false;
+    }
+    Metrics::count("db_commits_total");
+    if (newId) *newId = id;
+
+    Product added = p;
+    added.id = id;
+    SnapshotStore::instance().onProductSaved(added);
+
+    LowStockMonitor::instance().update(id, p.quantity, p.minStock);
+    ReportEngine::instance().invalidateAll();
+    LocationStock::instance().invalidate();
+    return true;
 }
 
 bool DbManager::updateProduct(const Product &p) {
+    ScopedTimer timer("db_update_product");
     QSqlQuery query;
     query.prepare("UPDATE products SET code=:code, name=:name, category=:cat, "
                   "unit=:unit, price=:price, min_stock=:min WHERE id=:id");
@@ -80,17 +328,90 @@ bool DbManager::updateProduct(const Product &p) {
     query.bindValue(":price", p.price);
     query.bindValue(":min", p.minStock);
     query.bindValue(":id", p.id);
-    return query.exec();
+    if (!query.exec()) return false;
+
+    //阈值可能变化，按库中的当前库存重新判断
+    Product current = getProductById(p.id);
+    if (current.id != -1) {
+        LowStockMonitor::instance().update(current.id, current.quantity, current.minStock);
+        SnapshotStore::instance().onProductSaved(current);
+    }
+    ReportEngine::instance().invalidateAll();
+    LocationStock::instance().invalidate();
+    return true;
+}
+
+//批量修改：语句只编译一次，每行重新绑定参数执行，整批一次提交
+bool DbManager::updateProductsBatch(const QList<Product> &products) {
+    ScopedTimer timer("db_update_products_batch");
+    timer.setRows(products.size());
+    if (products.isEmpty()) return true;
+
+    m_db.transaction();
+    QSqlQuery update;
+    bool ok = update.prepare("UPDATE products SET code=:code, name=:name, category=:cat, "
+                             "unit=:unit, price=:price, min_stock=:min WHERE id=:id AND deleted = 0");
+
+    for (int i = 0; ok && i < products.size(); ++i) {
+        const Product &p = products.at(i);
+        update.bindValue(":code", p.code);
+        update.bindValue(":name", p.name);
+        update.bindValue(":cat", p.category);
+        update.bindValue(":unit", p.unit);
+        update.bindValue(":price", p.price);
+        update.bindValue(":min", p.minStock);
+        update.bindValue(":id", p.id);
+        if (!update.exec() || update.numRowsAffected() == 0) {
+            qDebug() << "Batch Update Product Error:" << p.id << update.lastError();
+            ok = false;
+        }
+    }
+
+    if (!ok || !m_db.commit()) {
+        m_db.rollback();
+        Metrics::count("db_rollbacks_total");
+        return false;
+    }
+    Metrics::count("db_commits_total");
+
+    //库存数量没变，快照里保留原数量；阈值可能批量变化，低库存集合走一次部分索引重建
+    SnapshotStore::instance().onProductsUpdated(products);
+    LowStockMonitor::instance().reload();
+    ReportEngine::instance().invalidateAll();
+    LocationStock::instance().invalidate();
+    return true;
 }
 
 bool DbManager::deleteProduct(int id) {
+    ScopedTimer timer("db_delete_product");
     QSqlQuery query;
-    query.prepare("DELETE FROM products WHERE id = :id");
+    query.prepare("UPDATE products SET deleted = 1 WHERE id = :id AND deleted = 0");
     query.bindValue(":id", id);
-    return query.exec();
+    if (!query.exec() || query.numRowsAffected() == 0) return false;
+    SnapshotStore::instance().invalidateProducts();
+    LowStockMonitor::instance().remove(id);
+    ReportEngine::instance().invalidateAll();
+    LocationStock::instance().invalidate();
+    return true;
+}
+
+bool DbManager::restoreProduct(int id) {
+    ScopedTimer timer("db_restore_product");
+    QSqlQuery query;
+    query.prepare("UPDATE products SET deleted = 0 WHERE id = :id AND deleted = 1");
+    query.bindValue(":id", id);
+    if (!query.exec() || query.numRowsAffected() == 0) return false;
+    SnapshotStore::instance().invalidateProducts();
+
+    Product p = getProductById(id);
+    LowStockMonitor::instance().update(p.id, p.quantity, p.minStock);
+    ReportEngine::instance().invalidateAll();
+    LocationStock::instance().invalidate();
+    return true;
 }
 
 bool DbManager::isCodeExists(const QString &code) {
+    ScopedTimer timer("db_is_code_exists");
     QSqlQuery query;
     query.prepare("SELECT id FROM products WHERE code = :code");
     query.bindValue(":code", code);
@@ -98,121 +419,874 @@ bool DbManager::isCodeExists(const QString &code) {
     return false;
 }
 
+int DbManager::deletedProductId(const QString &code) {
+    QSqlQuery query;
+    query.prepare("SELECT id FROM products WHERE code = :code AND deleted = 1");
+    query.bindValue(":code", code);
+    if (query.exec() && query.next()) return query.value(0).toInt();
+    return -1;
+}
+
+//货品表的列顺序与下面的读取函数对应
+static const char *const ProductColumns = "id, code, name, category, unit, price, quantity, min_stock";
+
+static Product readProduct(const QSqlQuery &query) {
+    Product p;
+    p.id = query.value(0).toInt();
+    p.code = query.value(1).toString();
+    p.name = query.value(2).toString();
+    p.category = query.value(3).toString();
+    p.unit = query.value(4).toString();
+    p.price = query.value(5).toDouble();
+    p.quantity = query.value(6).toInt();
+    p.minStock = query.value(7).toInt();
+    return p;
+}
+
 QList<Product> DbManager::getAllProducts() {
+    ScopedTimer timer("db_get_all_products");
     QList<Product> list;
-    QSqlQuery query("SELECT * FROM products ORDER BY id DESC");
-    while (query.next()) {
-        Product p;
-        p.id = query.value("id").toInt();
-        p.code = query.value("code").toString();
-        p.name = query.value("name").toString();
-        p.category = query.value("category").toString();
-        p.unit = query.value("unit").toString();
-        p.price = query.value("price").toDouble();
-        p.quantity = query.value("quantity").toInt();
-        p.minStock = query.value("min_stock").toInt();
-        list.append(p);
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.exec(QString("SELECT %1 FROM products WHERE deleted = 0 ORDER BY id DESC").arg(ProductColumns));
+    while (query.next()) list.append(readProduct(query));
+    timer.setRows(list.size());
+    return list;
+}
+
+QList<Product> DbManager::getProductsPage(const QSqlDatabase &db, int beforeId, int limit) {
+    ScopedTimer timer("db_get_products_page");
+    QList<Product> list;
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare(QString("SELECT %1 FROM products WHERE deleted = 0 %2 ORDER BY id DESC LIMIT :limit")
+                      .arg(ProductColumns, beforeId < 0 ? "" : "AND id < :before"));
+    if (beforeId >= 0) query.bindValue(":before", beforeId);
+    query.bindValue(":limit", limit);
+    if (!query.exec()) {
+        qDebug() << "Get Products Page Error:" << query.lastError();
+        return list;
     }
+    while (query.next()) list.append(readProduct(query));
+    timer.setRows(list.size());
     return list;
 }
 
 Product DbManager::getProductById(int id) {
+    ScopedTimer timer("db_get_product_by_id");
     QSqlQuery query;
-    query.prepare("SELECT * FROM products WHERE id = :id");
+    query.prepare(QString("SELECT %1 FROM products WHERE id = :id").arg(ProductColumns));
     query.bindValue(":id", id);
     Product p;
     p.id = -1;
-    if (query.exec() && query.next()) {
-        p.id = query.value("id").toInt();
-        p.code = query.value("code").toString();
-        p.name = query.value("name").toString();
-        p.category = query.value("category").toString();
-        p.unit = query.value("unit").toString();
-        p.price = query.value("price").toDouble();
-        p.quantity = query.value("quantity").toInt();
-        p.minStock = query.value("min_stock").toInt();
-    }
+    if (query.exec() && query.next()) p = readProduct(query);
     return p;
 }
 
+//出入库提交后通知各个增量维护的模块（低库存、补货预测、报表、分仓汇总）
+//提交后把新记录和新的总库存写进共享快照（一次提交只发布一个新版本）
+void DbManager::publishMovements(const QVector<AppliedMovement> &moves) {
+    QVector<Record> records;
+    QHash<int, int> quantities;
+    records.reserve(moves.size());
+    for (const AppliedMovement &m : moves) {
+        records.append(m.record);
+        quantities.insert(m.productId, m.quantity); //同一货品多次变动时保留最后的数量
+    }
+    SnapshotStore::instance().onMovements(records, quantities);
+}
+
+void DbManager::notifyMovement(const AppliedMovement &m, qint64 timestamp) {
+    LowStockMonitor::instance().update(m.productId, m.quantity, m.minStock);
+    if (!m.isInbound) Forecaster::instance().addOutbound(m.productId, m.count, timestamp);
+    ReportEngine::instance().onMovement(m.productId, m.isInbound, m.count, timestamp, m.quantity);
+    LocationStock::instance().update(m.productId, m.locationId, m.locationQuantity);
+}
+
+//一个事务内反复使用的出入库语句：更新该仓库的 stock_levels 行，
+//同时维护 products.quantity 总数并写入记录
+class DbManager::StockWriter
+{
+public:
+    StockWriter() {
+        m_productSelect.prepare("SELECT quantity, min_stock, code, name FROM products WHERE id = :id AND deleted = 0");
+        //仓库不存在时没有结果行；仓库存在但还没有该货品时数量为 0
+        m_levelSelect.prepare("SELECT IFNULL(s.quantity, 0), l.name FROM locations l "
+                              "LEFT JOIN stock_levels s ON s.location_id = l.id AND s.product_id = :pid "
+                              "WHERE l.id = :loc");
+        m_levelUpsert.prepare("INSERT INTO stock_levels (product_id, location_id, quantity) "
+                              "VALUES (:pid, :loc, :qty) "
+                              "ON CONFLICT (product_id, location_id) DO UPDATE SET quantity = excluded.quantity");
+        m_productUpdate.prepare("UPDATE products SET quantity = :qty WHERE id = :id");
+        m_recordInsert.prepare("INSERT INTO records (product_id, type, count, timestamp, remark, "
+                               "location_id, peer_location_id, request_key, product_code, product_name) "
+                               "VALUES (:pid, :type, :count, :time, :remark, :loc, :peer, :key, :code, :name)");
+    }
+
+    // 幂等键是否已经记过账：先看内存过滤器，只有不能确定时才查唯一索引
+    bool isDuplicate(const QString &key) {
+        switch (RequestKeyFilter::instance().check(key)) {
+        case RequestKeyFilter::New: return false;
+        case RequestKeyFilter::Duplicate: return true;
+        case RequestKeyFilter::Maybe: break;
+        }
+        if (m_keySelect.lastQuery().isEmpty())
+            m_keySelect.prepare("SELECT 1 FROM records WHERE request_key = :key");
+        m_keySelect.bindValue(":key", key);
+        const bool found = m_keySelect.exec() && m_keySelect.next();
+        m_keySelect.finish();
+        return found;
+    }
+
+    // 返回空字符串表示成功；SQL 执行失败时 *sqlFailed 置为 true，调用方需回滚整个事务
+    QString apply(const StockMovement &m, qint64 timestamp, int peerLocation,
+                  AppliedMovement *applied, bool *sqlFailed) {
+        *sqlFailed = false;
+        if (m.count <= 0) return "数量必须大于0";
+
+        m_productSelect.bindValue(":id", m.productId);
+        if (!m_productSelect.exec() || !m_productSelect.next()) return "货品不存在";
+        int quantity = m_productSelect.value(0).toInt();
+        const int minStock = m_productSelect.value(1).toInt();
+        const QString code = m_productSelect.value(2).toString();
+        const QString name = m_productSelect.value(3).toString();
+        m_productSelect.finish();
+
+        m_levelSelect.bindValue(":pid", m.productId);
+        m_levelSelect.bindValue(":loc", m.locationId);
+        if (!m_levelSelect.exec() || !m_levelSelect.next()) return "仓库不存在";
+        int locationQuantity = m_levelSelect.value(0).toInt();
+        const QString locationName = m_levelSelect.value(1).toString();
+        m_levelSelect.finish();
+
+        //出库校验按仓库进行
+        if (!m.isInbound && locationQuantity < m.count)
+            return QString("库存不足！当前库存: %1, 申请出库: %2").arg(locationQuantity).arg(m.count);
+
+        const int delta = m.isInbound ? m.count : -m.count;
+        quantity += delta;
+        locationQuantity += delta;
+
+        m_levelUpsert.bindValue(":pid", m.productId);
+        m_levelUpsert.bindValue(":loc", m.locationId);
+        m_levelUpsert.bindValue(":qty", locationQuantity);
+        m_productUpdate.bindValue(":qty", quantity);
+        m_productUpdate.bindValue(":id", m.productId);
+        if (!m_levelUpsert.exec()) {
+            *sqlFailed = true;
+            return "更新库存失败: " + m_levelUpsert.lastError().text();
+        }
+        if (!m_productUpdate.exec()) {
+            *sqlFailed = true;
+            return "更新库存失败: " + m_productUpdate.lastError().text();
+        }
+
+        m_recordInsert.bindValue(":pid", m.productId);
+        m_recordInsert.bindValue(":type", m.isInbound ? 1 : 0);
+        m_recordInsert.bindValue(":count", m.count);
+        m_recordInsert.bindValue(":time", timestamp);
+        m_recordInsert.bindValue(":remark", m.remark);
+        m_recordInsert.bindValue(":loc", m.locationId);
+        m_recordInsert.bindValue(":peer", peerLocation);
+        m_recordInsert.bindValue(":key", m.requestKey.isEmpty() ? QVariant() : QVariant(m.requestKey));
+        m_recordInsert.bindValue(":code", code);
+        m_recordInsert.bindValue(":name", name);
+        if (!m_recordInsert.exec()) {
+            *sqlFailed = true;
+            return "写入记录失败: " + m_recordInsert.lastError().text();
+        }
+
+        *applied = {m.productId, m.locationId, m.count, m.isInbound, quantity, minStock, locationQuantity, Record()};
+        Record &r = applied->record;
+        r.id = m_recordInsert.lastInsertId().toInt();
+        r.productId = m.productId;
+        r.productCode = code;
+        r.productName = name;
+        r.type = m.isInbound ? 1 : 0;
+        r.count = m.count;
+        r.time = QDateTime::fromSecsSinceEpoch(timestamp);
+        r.remark = m.remark;
+        r.locationId = m.locationId;
+        r.locationName = locationName;
+        r.peerLocationId = peerLocation;
+        return QString();
+    }
+
+private:
+    QSqlQuery m_productSelect;
+    QSqlQuery m_levelSelect;
+    QSqlQuery m_levelUpsert;
+    QSqlQuery m_productUpdate;
+    QSqlQuery m_recordInsert;
+    QSqlQuery m_keySelect;
+};
+
 //事务处理出入库
-QString DbManager::adjustStock(int productId, int count, bool isInbound, const QString &remark) {
+QString DbManager::adjustStock(int productId, int count, bool isInbound, const QString &remark,
+                               int locationId, const QString &requestKey) {
+    ScopedTimer timer("db_adjust_stock");
+    timer.setRows(1);
     if (count <= 0) return "数量必须大于0";
+    //幂等键过滤器需要重建时在事务之外完成
+    if (!requestKey.isEmpty()) RequestKeyFilter::instance().ensureLoaded();
 
     //开启事务
     m_db.transaction();
 
-    //查询当前库存
-    Product p = getProductById(productId);
-    if (p.id == -1) {
+    StockWriter writer;
+    if (!requestKey.isEmpty() && writer.isDuplicate(requestKey)) {
         m_db.rollback();
-        return "货品不存在";
+        Metrics::count("db_duplicate_movements_total");
+        return "";
     }
 
-    int newQuantity = p.quantity;
-    if (isInbound) {
-        newQuantity += count;
+    AppliedMovement applied;
+    bool sqlFailed = false;
+    const qint64 now = QDateTime::currentDateTime().toSecsSinceEpoch();
+    QString error = writer.apply({productId, count, isInbound, remark, locationId, requestKey},
+                                 now, 0, &applied, &sqlFailed);
+    if (!error.isEmpty()) {
+        m_db.rollback();
+        Metrics::count(sqlFailed ? "db_rollbacks_total" : "db_adjust_stock_rejected_total");
+        return error;
+    }
+
+    //提交事务
+    if (m_db.commit()) {
+        Metrics::count("db_commits_total");
+        if (!requestKey.isEmpty()) RequestKeyFilter::instance().add(requestKey);
+        publishMovements({applied});
+        notifyMovement(applied, now);
+        return "";
     } else {
-        //出库校验
-        if (p.quantity < count) {
-            m_db.rollback();
-            return QString("库存不足！当前库存: %1, 申请出库: %2").arg(p.quantity).arg(count);
+        m_db.rollback();
+        Metrics::count("db_commit_failures_total");
+        return "事务提交失败";
+    }
+}
+
+//批量出入库：一个事务内逐条校验并写入，业务校验失败的条目跳过，SQL 错误则整批回滚
+QStringList DbManager::adjustStockBatch(const QList<StockMovement> &moves) {
+    ScopedTimer timer("db_adjust_stock_batch");
+    timer.setRows(moves.size());
+    QStringList results;
+    if (moves.isEmpty()) return results;
+    //同 adjustStock：过滤器需要重建时在事务之外完成（批内登记的键提交后才计入，事务中不会再触发重建）
+    for (const StockMovement &m : moves) {
+        if (!m.requestKey.isEmpty()) {
+            RequestKeyFilter::instance().ensureLoaded();
+            break;
         }
-        newQuantity -= count;
     }
 
-    //更新库存表
-    QSqlQuery updateQuery;
-    updateQuery.prepare("UPDATE products SET quantity = :qty WHERE id = :id");
-    updateQuery.bindValue(":qty", newQuantity);
-    updateQuery.bindValue(":id", productId);
+    m_db.transaction();
 
-    if (!updateQuery.exec()) {
+    StockWriter writer;
+    const qint64 now = QDateTime::currentDateTime().toSecsSinceEpoch();
+
+    //提交成功后才通知各增量模块；同一货品多次变动时按顺序应用，最终状态正确
+    QVector<AppliedMovement> changed;
+    changed.reserve(moves.size());
+    //本批已写入的幂等键：同一批内的重复也要拦下，提交后再登记到过滤器
+    QSet<QString> batchKeys;
+
+    for (const StockMovement &m : moves) {
+        if (!m.requestKey.isEmpty()
+            && (batchKeys.contains(m.requestKey) || writer.isDuplicate(m.requestKey))) {
+            Metrics::count("db_duplicate_movements_total");
+            results << "";
+            continue;
+        }
+
+        AppliedMovement applied;
+        bool sqlFailed = false;
+        QString error = writer.apply(m, now, 0, &applied, &sqlFailed);
+        if (sqlFailed) {
+            error = "批量写入失败: " + error;
+            m_db.rollback();
+            Metrics::count("db_rollbacks_total");
+            results.clear();
+            for (int i = 0; i < moves.size(); ++i) results << error;
+            return results;
+        }
+        if (!error.isEmpty()) {
+            Metrics::count("db_adjust_stock_rejected_total");
+            results << error;
+            continue;
+        }
+        results << "";
+        changed.append(applied);
+        if (!m.requestKey.isEmpty()) batchKeys.insert(m.requestKey);
+    }
+
+    if (m_db.commit()) {
+        Metrics::count("db_commits_total");
+        for (const QString &key : batchKeys) RequestKeyFilter::instance().add(key);
+        publishMovements(changed);
+        for (const AppliedMovement &c : changed) notifyMovement(c, now);
+    } else {
         m_db.rollback();
-        return "更新库存失败: " + updateQuery.lastError().text();
+        Metrics::count("db_commit_failures_total");
+        results.clear();
+        for (int i = 0; i < moves.size(); ++i) results << "事务提交失败";
     }
+    return results;
+}
 
-    //插入记录表
-    QSqlQuery recordQuery;
-    recordQuery.prepare("INSERT INTO records (product_id, type, count, timestamp, remark) "
-                        "VALUES (:pid, :type, :count, :time, :remark)");
-    recordQuery.bindValue(":pid", productId);
-    recordQuery.bindValue(":type", isInbound ? 1 : 0);
-    recordQuery.bindValue(":count", count);
-    recordQuery.bindValue(":time", QDateTime::currentDateTime().toSecsSinceEpoch());
-    recordQuery.bindValue(":remark", remark);
+//仓库管理
 
-    if (!recordQuery.exec()) {
+QList<Location> DbManager::getLocations() {
+    QList<Location> list;
+    QSqlQuery query("SELECT id, code, name FROM locations ORDER BY id");
+    while (query.next()) {
+        Location l;
+        l.id = query.value(0).toInt();
+        l.code = query.value(1).toString();
+        l.name = query.value(2).toString();
+        list.append(l);
+    }
+    return list;
+}
+
+bool DbManager::addLocation(const Location &l) {
+    QSqlQuery query;
+    query.prepare("INSERT INTO locations (code, name) VALUES (:code, :name)");
+    query.bindValue(":code", l.code);
+    query.bindValue(":name", l.name);
+    if (!query.exec()) return false;
+    LocationStock::instance().invalidate();
+    return true;
+}
+
+//调拨：调出仓库一条出库、调入仓库一条入库，互相记录对方仓库
+//货品总库存不变，因此只更新分仓汇总，不通知低库存、预测和报表
+QString DbManager::transferStock(int productId, int fromLocation, int toLocation, int count,
+                                 const QString &remark) {
+    ScopedTimer timer("db_transfer_stock");
+    timer.setRows(2);
+    if (count <= 0) return "数量必须大于0";
+    if (fromLocation == toLocation) return "调出和调入仓库不能相同";
+
+    m_db.transaction();
+
+    StockWriter writer;
+    AppliedMovement out, in;
+    bool sqlFailed = false;
+    const qint64 now = QDateTime::currentDateTime().toSecsSinceEpoch();
+    QString error = writer.apply({productId, count, false, remark, fromLocation}, now, toLocation, &out, &sqlFailed);
+    if (error.isEmpty())
+        error = writer.apply({productId, count, true, remark, toLocation}, now, fromLocation, &in, &sqlFailed);
+    if (!error.isEmpty()) {
         m_db.rollback();
-        return "写入记录失败: " + recordQuery.lastError().text();
+        Metrics::count(sqlFailed ? "db_rollbacks_total" : "db_adjust_stock_rejected_total");
+        return error;
     }
 
-    //提交事务
-    if (m_db.commit()) {
-        return "";
-    } else {
+    if (!m_db.commit()) {
         m_db.rollback();
+        Metrics::count("db_commit_failures_total");
         return "事务提交失败";
     }
+    Metrics::count("db_commits_total");
+    publishMovements({out, in});
+    LocationStock::instance().update(productId, fromLocation, out.locationQuantity);
+    LocationStock::instance().update(productId, toLocation, in.locationQuantity);
+    return "";
+}
+
+//没有任何分仓记录的货品（升级前的数据、批量导入、旧快照）整体归入默认仓库，
+//已删除货品的分仓记录清掉
+bool DbManager::reconcileStockLevels() {
+    QSqlQuery query;
+    bool ok = query.exec(QString("INSERT OR IGNORE INTO locations (id, code, name) VALUES (%1, 'MAIN', '默认仓库')")
+                             .arg(DefaultLocationId))
+              && query.exec(QString("INSERT INTO stock_levels (product_id, location_id, quantity) "
+                                    "SELECT p.id, %1, p.quantity FROM products p WHERE NOT EXISTS "
+                                    "(SELECT 1 FROM stock_levels s WHERE s.product_id = p.id)")
+                                .arg(DefaultLocationId))
+              && query.exec("DELETE FROM stock_levels WHERE product_id NOT IN (SELECT id FROM products)");
+    if (!ok) qDebug() << "Reconcile Stock Levels Error:" << query.lastError();
+    LocationStock::instance().invalidate();
+    return ok;
 }
 
+//给没有冗余货品编号/名称的记录补上（升级前的数据、旧快照），按 ID 分段，每段一个事务，
+//避免大表上一个长事务长时间占住写锁。货品在有软删除之前就被彻底删掉的记录写入占位的
+//"#货品ID"，补过一次的记录不会再是 NULL，之后不会反复扫描
+bool DbManager::backfillRecordProducts() {
+    ScopedTimer timer("db_backfill_record_products");
+    QSqlQuery query;
+    if (!query.exec("SELECT min(id), max(id) FROM records WHERE product_name IS NULL") || !query.next()) {
+        qDebug() << "Backfill Records Error:" << query.lastError();
+        return false;
+    }
+    if (query.value(0).isNull()) return true;
+    const qint64 minId = query.value(0).toLongLong();
+    const qint64 maxId = query.value(1).toLongLong();
+    query.finish();
+
+    const qint64 chunk = 50000;
+    qint64 updated = 0;
+    query.prepare("UPDATE records SET "
+                  "product_code = COALESCE((SELECT code FROM products p WHERE p.id = records.product_id), "
+                  "                        '#' || records.product_id), "
+                  "product_name = COALESCE((SELECT name FROM products p WHERE p.id = records.product_id), "
+                  "                        '#' || records.product_id) "
+                  "WHERE id BETWEEN :lo AND :hi AND product_name IS NULL");
+    for (qint64 lo = minId; lo <= maxId; lo += chunk) {
+        m_db.transaction();
+        query.bindValue(":lo", lo);
+        query.bindValue(":hi", lo + chunk - 1);
+        if (!query.exec() || !m_db.commit()) {
+            qDebug() << "Backfill Records Error:" << query.lastError();
+            m_db.rollback();
+            return false;
+        }
+        updated += query.numRowsAffected();
+    }
+    if (updated > 0) SnapshotStore::instance().invalidateRecords();
+    timer.setRows(updated);
+    return true;
+}
+
+//仓库名称表很小，读记录时在内存中查，不再关联 locations
+static QHash<int, QString> locationNames(const QList<Location> &locations) {
+    QHash<int, QString> names;
+    for (const Location &l : locations) names.insert(l.id, l.name);
+    return names;
+}
+
+//只读 records 一张表：货品编号和名称在记账时已冗余保存，货品删除或改名不影响历史
 QList<Record> DbManager::getAllRecords() {
+    ScopedTimer timer("db_get_all_records");
+    QList<Record> list;
+    const QHash<int, QString> locations = locationNames(getLocations());
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.exec("SELECT id, product_id, product_code, product_name, type, count, timestamp, remark, "
+               "location_id, peer_location_id FROM records ORDER BY timestamp DESC, id DESC");
+
+    while (query.next()) {
+        Record r;
+        r.id = query.value(0).toInt();
+        r.productId = query.value(1).toInt();
+        r.productCode = query.value(2).toString();
+        r.productName = query.value(3).toString();
+        r.type = query.value(4).toInt();
+        r.count = query.value(5).toInt();
+        r.time = QDateTime::fromSecsSinceEpoch(query.value(6).toLongLong());
+        r.remark = query.value(7).toString();
+        r.locationId = query.value(8).toInt();
+        r.locationName = locations.value(r.locationId);
+        r.peerLocationId = query.value(9).toInt();
+        list.append(r);
+    }
+    timer.setRows(list.size());
+    return list;
+}
+
+QList<Record> DbManager::getProductRecords(int productId, qint64 beforeTs, int beforeId, int limit) {
+    ScopedTimer timer("db_get_product_records");
+    QList<Record> list;
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    //键集分页：以上一页最后一条的 (时间, ID) 为起点，不使用 OFFSET
+    query.prepare(QString("SELECT id, type, count, timestamp, remark, location_id, "
+                          "peer_location_id, product_code, product_name FROM records "
+                          "WHERE product_id = :pid %1 "
+                          "ORDER BY timestamp DESC, id DESC LIMIT :limit")
+                      .arg(beforeTs < 0 ? "" : "AND (timestamp, id) < (:ts, :id)"));
+    query.bindValue(":pid", productId);
+    if (beforeTs >= 0) {
+        query.bindValue(":ts", beforeTs);
+        query.bindValue(":id", beforeId);
+    }
+    query.bindValue(":limit", limit);
+    if (!query.exec()) {
+        qDebug() << "Get Product Records Error:" << query.lastError();
+        return list;
+    }
+
+    const QHash<int, QString> locations = locationNames(getLocations());
+    while (query.next()) {
+        Record r;
+        r.id = query.value(0).toInt();
+        r.productId = productId;
+        r.type = query.value(1).toInt();
+        r.count = query.value(2).toInt();
+        r.time = QDateTime::fromSecsSinceEpoch(query.value(3).toLongLong());
+        r.remark = query.value(4).toString();
+        r.locationId = query.value(5).toInt();
+        r.peerLocationId = query.value(6).toInt();
+        r.locationName = locations.value(r.locationId);
+        r.productCode = query.value(7).toString();
+        r.productName = query.value(8).toString();
+        list.append(r);
+    }
+    timer.setRows(list.size());
+    return list;
+}
+
+//全文检索
+//records_fts / products_fts 是外部内容表，只存倒排索引，原文仍在 records / products 中，
+//由触发器在同一事务里同步
+
+static const char *const FullTextTriggers[] = {
+    "CREATE TRIGGER IF NOT EXISTS records_fts_ai AFTER INSERT ON records BEGIN "
+    "INSERT INTO records_fts (rowid, remark, product_code, product_name) "
+    "VALUES (new.id, new.remark, new.product_code, new.product_name); END",
+    "CREATE TRIGGER IF NOT EXISTS records_fts_ad AFTER DELETE ON records BEGIN "
+    "INSERT INTO records_fts (records_fts, rowid, remark, product_code, product_name) "
+    "VALUES ('delete', old.id, old.remark, old.product_code, old.product_name); END",
+    "CREATE TRIGGER IF NOT EXISTS records_fts_au AFTER UPDATE OF remark, product_code, product_name ON records BEGIN "
+    "INSERT INTO records_fts (records_fts, rowid, remark, product_code, product_name) "
+    "VALUES ('delete', old.id, old.remark, old.product_code, old.product_name); "
+    "INSERT INTO records_fts (rowid, remark, product_code, product_name) "
+    "VALUES (new.id, new.remark, new.product_code, new.product_name); END",
+    "CREATE TRIGGER IF NOT EXISTS products_fts_ai AFTER INSERT ON products BEGIN "
+    "INSERT INTO products_fts (rowid, code, name, category) VALUES (new.id, new.code, new.name, new.category); END",
+    "CREATE TRIGGER IF NOT EXISTS products_fts_ad AFTER DELETE ON products BEGIN "
+    "INSERT INTO products_fts (products_fts, rowid, code, name, category) "
+    "VALUES ('delete', old.id, old.code, old.name, old.category); END",
+    "CREATE TRIGGER IF NOT EXISTS products_fts_au AFTER UPDATE OF code, name, category ON products BEGIN "
+    "INSERT INTO products_fts (products_fts, rowid, code, name, category) "
+    "VALUES ('delete', old.id, old.code, old.name, old.category); "
+    "INSERT INTO products_fts (rowid, code, name, category) VALUES (new.id, new.code, new.name, new.category); END"
+};
+
+static bool hasFullTextTables(QSqlDatabase db) {
+    QSqlQuery query(db);
+    return query.exec("SELECT count(*) FROM sqlite_master WHERE name IN ('records_fts', 'products_fts')")
+           && query.next() && query.value(0).toInt() == 2;
+}
+
+bool DbManager::setFullTextTriggers(QSqlDatabase db, bool enabled) {
+    if (!hasFullTextTables(db)) return true;
+    QSqlQuery query(db);
+    if (enabled) {
+        for (const char *sql : FullTextTriggers) {
+            if (!query.exec(QString::fromLatin1(sql))) {
+                qDebug() << "Create FTS Trigger Error:" << query.lastError();
+                return false;
+            }
+        }
+        return true;
+    }
+    for (const char *name : {"records_fts_ai", "records_fts_ad", "records_fts_au",
+                             "products_fts_ai", "products_fts_ad", "products_fts_au"}) {
+        if (!query.exec(QString("DROP TRIGGER IF EXISTS %1").arg(name))) return false;
+    }
+    return true;
+}
+
+bool DbManager::rebuildFullText(QSqlDatabase db) {
+    if (!hasFullTextTables(db)) return true;
+    ScopedTimer timer("db_rebuild_full_text");
+    QSqlQuery query(db);
+    const bool ok = query.exec("INSERT INTO records_fts (records_fts) VALUES ('rebuild')")
+                    && query.exec("INSERT INTO products_fts (products_fts) VALUES ('rebuild')");
+    if (!ok) qDebug() << "Rebuild FTS Error:" << query.lastError();
+    return ok;
+}
+
+//优先使用 trigram 分词（SQLite 3.34+），中文没有空格，unicode61 只能做前缀匹配。
+//建表、装触发器和整体建索引在同一个事务里：中途失败或退出时不会留下缺内容的索引
+bool DbManager::createFullText(QSqlDatabase db, bool *trigram) {
+    ScopedTimer timer("db_create_full_text");
+    QSqlQuery query(db);
+    db.transaction();
+    bool created = false;
+    for (const QString &tokenizer : {QString("trigram"), QString("unicode61")}) {
+        created = query.exec(QString("CREATE VIRTUAL TABLE records_fts USING fts5("
+                                     "remark, product_code, product_name, "
+                                     "content='records', content_rowid='id', tokenize='%1')").arg(tokenizer))
+                  && query.exec(QString("CREATE VIRTUAL TABLE products_fts USING fts5("
+                                        "code, name, category, "
+                                        "content='products', content_rowid='id', tokenize='%1')").arg(tokenizer));
+        if (created) {
+            *trigram = (tokenizer == "trigram");
+            break;
+        }
+        qDebug() << "Create FTS Tables Error:" << tokenizer << query.lastError();
+        query.exec("DROP TABLE IF EXISTS records_fts");
+    }
+    //已有数据一次性建索引，之后由触发器增量维护
+    if (created && setFullTextTriggers(db, true) && rebuildFullText(db) && db.commit())
+        return true;
+    db.rollback();
+    return false;
+}
+
+//已有可用的索引时只装回触发器；没有索引时在后台线程用独立连接建立（记录多时要几十秒），
+//建好之前搜索先走 LIKE 扫描，建好后回到界面线程再调用一次本函数启用
+bool DbManager::ensureFullTextIndex() {
+    QSqlQuery query;
+    if (query.exec("SELECT sql FROM sqlite_master WHERE name = 'records_fts'") && query.next()) {
+        const bool trigram = query.value(0).toString().contains("trigram");
+        //表可能由另一个 SQLite 建立（恢复的备份）：当前库没有 FTS5 或不支持其分词器时无法读取，
+        //此时去掉触发器（否则每次写记录都会失败），按当前库重新建
+        if (query.exec("SELECT rowid FROM records_fts LIMIT 0") && query.exec("SELECT rowid FROM products_fts LIMIT 0")) {
+            m_fullTextTrigram = trigram;
+            return setFullTextTriggers(m_db, true);
+        }
+        qDebug() << "FTS Tables Unusable:" << query.lastError();
+        if (!setFullTextTriggers(m_db, false) || !query.exec("DROP TABLE IF EXISTS records_fts")
+            || !query.exec("DROP TABLE IF EXISTS products_fts"))
+            return false;
+    }
+
+    if (m_fullTextBuild.isRunning()) return false;
+    const QString path = databasePath();
+    m_fullTextBuild = QtConcurrent::run([path] {
+        const QString name = "FullTextBuilder";
+        bool ok = false;
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+            db.setDatabaseName(path);
+            bool trigram = false;
+            ok = db.open() && createFullText(db, &trigram);
+        }
+        QSqlDatabase::removeDatabase(name);
+        //失败时保持 LIKE 扫描，不再重试（多半是 SQLite 没有编译 FTS5）
+        if (ok) {
+            QMetaObject::invokeMethod(qApp, [] {
+                DbManager &db = DbManager::instance();
+                db.m_fullText = db.ensureFullTextIndex();
+            }, Qt::QueuedConnection);
+        }
+        return ok;
+    });
+    return false;
+}
+
+void DbManager::waitForFullText() {
+    m_fullTextBuild.waitForFinished();
+    if (!m_fullText && m_fullTextBuild.resultCount() > 0 && m_fullTextBuild.result())
+        m_fullText = ensureFullTextIndex();
+}
+
+//每个关键词作为一个带引号的短语，多个关键词之间为"与"；
+//trigram 分词至少需要 3 个字符，unicode61 分词按前缀匹配
+QString DbManager::fullTextQuery(const QString &text) const {
+    if (!m_fullText) return QString();
+    QStringList terms;
+    const QString simplified = text.simplified();
+    if (simplified.isEmpty()) return QString();
+    for (QString term : simplified.split(' ')) {
+        if (m_fullTextTrigram && term.size() < 3) return QString();
+        term.replace('"', "\"\"");
+        terms << '"' + term + '"' + (m_fullTextTrigram ? "" : "*");
+    }
+    return terms.join(' ');
+}
+
+QList<Record> DbManager::searchRecords(const QString &text, int offset, int limit) {
+    ScopedTimer timer("db_search_records");
     QList<Record> list;
-    QSqlQuery query("SELECT r.*, p.name as p_name FROM records r "
-                    "LEFT JOIN products p ON r.product_id = p.id "
-                    "ORDER BY r.timestamp DESC");
+    const QString match = fullTextQuery(text);
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    if (!match.isEmpty()) {
+        query.prepare("SELECT r.id, r.product_id, r.product_code, r.product_name, r.type, r.count, "
+                      "r.timestamp, r.remark, r.location_id, r.peer_location_id "
+                      "FROM (SELECT rowid, rank FROM records_fts WHERE records_fts MATCH :match "
+                      "      ORDER BY rank LIMIT :limit OFFSET :offset) f "
+                      "JOIN records r ON r.id = f.rowid ORDER BY f.rank");
+        query.bindValue(":match", match);
+    } else {
+        //关键词太短或没有全文索引：按时间倒序扫描，取满一页即停止；
+        //输入中的 % _ 按字面匹配，用 \ 转义
+        Metrics::count("db_search_records_fallback_total");
+        query.prepare("SELECT id, product_id, product_code, product_name, type, count, "
+                      "timestamp, remark, location_id, peer_location_id FROM records "
+                      "WHERE remark LIKE :p1 ESCAPE '\\' OR product_code LIKE :p2 ESCAPE '\\' "
+                      "OR product_name LIKE :p3 ESCAPE '\\' "
+                      "ORDER BY timestamp DESC, id DESC LIMIT :limit OFFSET :offset");
+        QString escaped = text.trimmed();
+        escaped.replace('\\', "\\\\").replace('%', "\\%").replace('_', "\\_");
+        const QString pattern = "%" + escaped + "%";
+        query.bindValue(":p1", pattern);
+        query.bindValue(":p2", pattern);
+        query.bindValue(":p3", pattern);
+    }
+    query.bindValue(":limit", limit);
+    query.bindValue(":offset", offset);
+    if (!query.exec()) {
+        qDebug() << "Search Records Error:" << query.lastError();
+        return list;
+    }
 
+    const QHash<int, QString> locations = locationNames(getLocations());
     while (query.next()) {
         Record r;
-        r.id = query.value("id").toInt();
-        r.productId = query.value("product_id").toInt();
-        r.productName = query.value("p_name").toString(); // 这里的别名 p_name
-        r.type = query.value("type").toInt();
-        r.count = query.value("count").toInt();
-        r.time = QDateTime::fromSecsSinceEpoch(query.value("timestamp").toLongLong());
-        r.remark = query.value("remark").toString();
+        r.id = query.value(0).toInt();
+        r.productId = query.value(1).toInt();
+        r.productCode = query.value(2).toString();
+        r.productName = query.value(3).toString();
+        r.type = query.value(4).toInt();
+        r.count = query.value(5).toInt();
+        r.time = QDateTime::fromSecsSinceEpoch(query.value(6).toLongLong());
+        r.remark = query.value(7).toString();
+        r.locationId = query.value(8).toInt();
+        r.locationName = locations.value(r.locationId);
+        r.peerLocationId = query.value(9).toInt();
         list.append(r);
     }
+    timer.setRows(list.size());
     return list;
 }
 
+bool DbManager::searchProductIds(const QString &text, QSet<int> *ids) {
+    const QString match = fullTextQuery(text);
+    if (match.isEmpty()) return false;
+    ScopedTimer timer("db_search_products");
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.prepare("SELECT p.id FROM products_fts f JOIN products p ON p.id = f.rowid "
+                  "WHERE products_fts MATCH :match AND p.deleted = 0");
+    query.bindValue(":match", match);
+    if (!query.exec()) {
+        qDebug() << "Search Products Error:" << query.lastError();
+        return false;
+    }
+    ids->clear();
+    while (query.next()) ids->insert(query.value(0).toInt());
+    timer.setRows(ids->size());
+    return true;
+}
+
+//历史库存：检查点
+
+bool DbManager::createCheckpoint() {
+    ScopedTimer timer("db_create_checkpoint");
+    const qint64 now = QDateTime::currentDateTime().toSecsSinceEpoch();
+
+    //同一秒内已有检查点时（如每日检查点之后紧接着导入）用这一刻的数据替换它，
+    //检查点以秒为键，同一秒内较晚的状态同样正确
+    m_db.transaction();
+    QSqlQuery query;
+    query.prepare("INSERT OR REPLACE INTO checkpoints (ts, last_record_id) "
+                  "SELECT :ts, IFNULL(MAX(id), 0) FROM records");
+    query.bindValue(":ts", now);
+    bool replaced = query.exec();
+    if (replaced) {
+        query.prepare("DELETE FROM checkpoint_stock WHERE ts = :ts");
+        query.bindValue(":ts", now);
+        replaced = query.exec();
+    }
+    if (replaced) {
+        query.prepare("INSERT INTO checkpoint_stock (ts, product_id, quantity) "
+                      "SELECT :ts, id, quantity FROM products");
+        query.bindValue(":ts", now);
+    }
+    if (!replaced || !query.exec()) {
+        qDebug() << "Create Checkpoint Error:" << query.lastError();
+        m_db.rollback();
+        return false;
+    }
+    timer.setRows(query.numRowsAffected());
+
+    //清理旧检查点（与新检查点同一个事务）：每个检查点有全部货品各一行，不清理时每年增长
+    //"货品数 × 365" 行；月末的检查点足够让更早的历史查询只回放一个月以内的记录
+    const qint64 cutoff = now - qint64(CheckpointDailyDays) * 24 * 3600;
+    query.prepare("DELETE FROM checkpoints WHERE ts < :cutoff AND ts NOT IN ("
+                  "SELECT MAX(ts) FROM checkpoints WHERE ts < :cutoff2 "
+                  "GROUP BY strftime('%Y-%m', ts, 'unixepoch', 'localtime'))");
+    query.bindValue(":cutoff", cutoff);
+    query.bindValue(":cutoff2", cutoff);
+    bool ok = query.exec();
+    if (ok && query.numRowsAffected() > 0) {
+        Metrics::count("db_checkpoints_pruned_total", query.numRowsAffected());
+        query.prepare("DELETE FROM checkpoint_stock WHERE ts < :cutoff "
+                      "AND ts NOT IN (SELECT ts FROM checkpoints WHERE ts < :cutoff2)");
+        query.bindValue(":cutoff", cutoff);
+        query.bindValue(":cutoff2", cutoff);
+        ok = query.exec();
+    }
+    if (!ok) {
+        qDebug() << "Prune Checkpoints Error:" << query.lastError();
+        m_db.rollback();
+        return false;
+    }
+    return m_db.commit();
+}
+
+bool DbManager::ensureDailyCheckpoint() {
+    QSqlQuery query("SELECT MAX(ts) FROM checkpoints");
+    qint64 last = 0;
+    if (query.next() && !query.value(0).isNull()) last = query.value(0).toLongLong();
+    if (QDateTime::currentDateTime().toSecsSinceEpoch() - last < 24 * 3600) return true;
+    return createCheckpoint();
+}
+
+//从最近的检查点出发，只回放检查点与目标时刻之间的记录：
+//目标时刻之前的检查点向后回放，之后的检查点（或当前库存）向前倒推，取时间上更近的一个。
+//有软删除之前被彻底删掉的货品没有库存行，它们的记录不参与计算，否则倒推出负的库存
+QHash<int, int> DbManager::getStockAt(const QDateTime &at, const QList<int> &productIds) {
+    ScopedTimer timer("db_get_stock_at");
+    const qint64 t = at.toSecsSinceEpoch();
+    const qint64 now = QDateTime::currentDateTime().toSecsSinceEpoch();
+    QHash<int, int> stock;
+    QSqlQuery query;
+
+    qint64 beforeTs = -1, beforeId = 0;
+    query.prepare("SELECT ts, last_record_id FROM checkpoints WHERE ts <= :t ORDER BY ts DESC LIMIT 1");
+    query.bindValue(":t", t);
+    if (query.exec() && query.next()) {
+        beforeTs = query.value(0).toLongLong();
+        beforeId = query.value(1).toLongLong();
+    }
+
+    qint64 afterTs = now, afterId = -1; // -1 表示以当前库存为终点
+    query.prepare("SELECT ts, last_record_id FROM checkpoints WHERE ts > :t ORDER BY ts ASC LIMIT 1");
+    query.bindValue(":t", t);
+    if (query.exec() && query.next()) {
+        afterTs = query.value(0).toLongLong();
+        afterId = query.value(1).toLongLong();
+    }
+
+    const bool forward = beforeTs >= 0 && (t - beforeTs) <= (afterTs - t);
+
+    if (forward) {
+        //检查点数量 + (检查点之后、目标时刻及之前) 的变动
+        query.prepare("SELECT product_id, quantity FROM checkpoint_stock WHERE ts = :ts");
+        query.bindValue(":ts", beforeTs);
+        query.exec();
+        while (query.next()) stock.insert(query.value(0).toInt(), query.value(1).toInt());
+
+        query.prepare("SELECT product_id, SUM(CASE type WHEN 1 THEN count ELSE -count END) "
+                      "FROM records WHERE timestamp <= :t AND id > :lastId "
+                      "AND product_id IN (SELECT id FROM products) GROUP BY product_id");
+        query.bindValue(":t", t);
+        query.bindValue(":lastId", beforeId);
+        query.exec();
+        while (query.next()) stock[query.value(0).toInt()] += query.value(1).toInt();
+    } else {
+        //终点数量 - (目标时刻之后、终点及之前) 的变动
+        if (afterId < 0) {
+            query.exec("SELECT id, quantity FROM products");
+        } else {
+            query.prepare("SELECT product_id, quantity FROM checkpoint_stock WHERE ts = :ts");
+            query.bindValue(":ts", afterTs);
+            query.exec();
+        }
+        while (query.next()) stock.insert(query.value(0).toInt(), query.value(1).toInt());
+
+        query.prepare(QString("SELECT product_id, SUM(CASE type WHEN 1 THEN count ELSE -count END) "
+                              "FROM records WHERE timestamp > :t %1 "
+                              "AND product_id IN (SELECT id FROM products) GROUP BY product_id")
+                          .arg(afterId < 0 ? "" : "AND id <= :lastId"));
+        query.bindValue(":t", t);
+        if (afterId >= 0) query.bindValue(":lastId", afterId);
+        query.exec();
+        while (query.next()) stock[query.value(0).toInt()] -= query.value(1).toInt();
+    }
+
+    if (!productIds.isEmpty()) {
+        QHash<int, int> subset;
+        for (int id : productIds) subset.insert(id, stock.value(id, 0));
+        stock.swap(subset);
+    }
+    timer.setRows(stock.size());
+    return stock;
+}
@@ -3,31 +3,88 @@
 
 #include <QSqlDatabase>
 #include <QList>
+#include <QStringList>
 #include <QMutex>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QFuture>
 #include "warehousedata.h"
 
+class QSqlQuery;
+
 class DbManager
 {
 public:
     static DbManager& instance();
 
-    bool init(); // 初始化数据库和表
+    static const int SchemaVersion = 2; // 当前数据库结构版本（PRAGMA user_version）
+
+    bool init(const QString &dbPath = QString()); // 初始化数据库和表（为空时使用程序目录下的 warehouse.db）
+    static QString databasePath(); // 当前数据库文件路径，后台线程建立独立连接时使用
+    bool restoreFrom(const QString &path, QString *error); // 用备份文件覆盖当前数据库（界面线程，阻塞）
 
     // --- 货品管理 (CRUD) ---
-    bool addProduct(const Product &p);
+    bool addProduct(const Product &p, int *newId = nullptr);
     bool updateProduct(const Product &p);
-    bool deleteProduct(int id);
+    // 批量修改货品资料（不含库存数量）：整批在同一个事务中用一条预编译语句写入，
+    // 任一条失败（如货品已被删除）则整批回滚
+    bool updateProductsBatch(const QList<Product> &products);
+    bool deleteProduct(int id);   // 软删除：货品行保留，历史记录仍能查到名称
+    bool restoreProduct(int id);  // 恢复软删除的货品（撤销删除）
     QList<Product> getAllProducts();
+    // 按 ID 倒序分页读取货品（beforeId < 0 表示从最新开始）；不使用默认连接，
+    // 可在任意线程调用，db 须是该线程自己的连接
+    static QList<Product> getProductsPage(const QSqlDatabase &db, int beforeId, int limit);
     Product getProductById(int id);
-    bool isCodeExists(const QString &code); // 检查编号是否重复
+    bool isCodeExists(const QString &code); // 检查编号是否重复（含已删除的货品，编号唯一约束仍然有效）
+    int deletedProductId(const QString &code); // 编号属于已删除的货品时返回其ID，否则返回 -1
 
     // --- 核心业务：出入库操作 ---
     // 返回值: 空字符串表示成功，非空字符串表示具体的错误信息（如"库存不足"）
-    QString adjustStock(int productId, int count, bool isInbound, const QString &remark);
+    // requestKey 非空且已经记过账时不再重复执行，直接返回成功
+    QString adjustStock(int productId, int count, bool isInbound, const QString &remark,
+                        int locationId = DefaultLocationId, const QString &requestKey = QString());
+    // 批量出入库：整批在同一个事务中提交，返回值与 moves 一一对应（空字符串表示该条成功，
+    // 幂等键重复的条目同样视为成功）
+    QStringList adjustStockBatch(const QList<StockMovement> &moves);
+
+    // --- 仓库 / 库位 ---
+    QList<Location> getLocations();
+    bool addLocation(const Location &l);
+    // 调拨：调出、调入两条记录在同一个事务中写入，货品总库存不变
+    QString transferStock(int productId, int fromLocation, int toLocation, int count, const QString &remark);
+    // 让 stock_levels 与货品总库存对齐（升级旧库、批量导入或恢复快照后调用）
+    bool reconcileStockLevels();
 
     // --- 记录查询 ---
+    // 给缺少冗余货品编号/名称的记录补上（升级旧库或恢复旧快照后调用）
+    bool backfillRecordProducts();
     QList<Record> getAllRecords();
     QList<Record> getRecordsByDateRange(const QDateTime &start, const QDateTime &end);
+    // 单个货品的记录，按 (时间, ID) 倒序分页：返回排在 (beforeTs, beforeId) 之后的 limit 条，
+    // beforeTs < 0 表示从最新一条开始（走 idx_records_pid_ts 索引范围扫描，与记录总数无关）
+    QList<Record> getProductRecords(int productId, qint64 beforeTs, int beforeId, int limit);
+
+    // --- 全文检索（FTS5） ---
+    bool fullTextAvailable() const { return m_fullText; }
+    // 等后台的首次建索引结束并启用（没有事件循环的场合，如基准测试）
+    void waitForFullText();
+    // 按备注、货品编号、名称搜索记录，按相关度排序分页；没有全文索引或关键词太短时退回 LIKE 扫描
+    QList<Record> searchRecords(const QString &text, int offset, int limit);
+    // 按编号、名称、分类搜索未删除的货品；无法使用全文索引时返回 false，由调用方自行过滤
+    bool searchProductIds(const QString &text, QSet<int> *ids);
+    // 批量导入时先去掉同步触发器，导入完成后再装回并整体重建索引（db 为导入所用的连接）
+    static bool setFullTextTriggers(QSqlDatabase db, bool enabled);
+    static bool rebuildFullText(QSqlDatabase db);
+
+    // --- 历史库存（检查点 + 回放） ---
+    // 检查点保留策略：最近 CheckpointDailyDays 天的全部保留，更早的每个自然月只留最后一个
+    static const int CheckpointDailyDays = 90;
+    bool createCheckpoint();       // 记录当前全部货品库存的检查点，并按保留策略清理旧检查点
+    bool ensureDailyCheckpoint();  // 距上一个检查点超过一天时创建新检查点
+    // 重建某一时刻的库存（货品ID -> 数量）；productIds 为空表示全部货品
+    QHash<int, int> getStockAt(const QDateTime &at, const QList<int> &productIds = QList<int>());
 
 private:
     DbManager();
@@ -35,7 +92,33 @@ private:
     DbManager(const DbManager&) = delete;
     DbManager& operator=(const DbManager&) = delete;
 
+    class StockWriter;
+
+    // 一笔已写入的变动及写入后的库存状态，事务提交后用于通知各增量模块
+    struct AppliedMovement {
+        int productId;
+        int locationId;
+        int count;
+        bool isInbound;
+        int quantity;          // 货品总库存
+        int minStock;
+        int locationQuantity;  // 该仓库库存
+        Record record;         // 写入的记录（更新共享快照用）
+    };
+    void notifyMovement(const AppliedMovement &m, qint64 timestamp);
+    void publishMovements(const QVector<AppliedMovement> &moves);
+
+    bool initSchema(); // 建表和版本升级（启动时、从备份恢复后）
+    bool replaceSchemaFrom(const QString &source, QSqlQuery *query); // 用附加的数据库替换 main 的内容（在事务中调用）
+    bool ensureFullTextIndex();
+    static bool createFullText(QSqlDatabase db, bool *trigram); // 建全文索引表、触发器并整体建索引
+    QString fullTextQuery(const QString &text) const; // 把用户输入转成 MATCH 表达式，无法使用时返回空
+
     QSqlDatabase m_db;
+    bool m_fullText;         // 全文索引可用（SQLite 编译时启用了 FTS5）
+    bool m_fullTextTrigram;  // 使用 trigram 分词（中文任意子串可搜），否则为 unicode61
+    QFuture<bool> m_fullTextBuild; // 后台首次建全文索引
+    static QString s_dbPath;
 };
 
 #endif // DBMANAGER_H
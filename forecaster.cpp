@@ -0,0 +1,177 @@
+#include "forecaster.h"
+#include "metrics.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDateTime>
+#include <QDebug>
+#include <QtConcurrent>
+#include <cstring>
+
+static const float SmoothingAlpha = 0.2f;
+
+Forecaster::Forecaster() : m_today(0), m_utcOffset(0) {}
+
+Forecaster& Forecaster::instance() {
+    static Forecaster instance;
+    return instance;
+}
+
+void Forecaster::reload() {
+    ScopedTimer timer("forecast_reload");
+    m_utcOffset = QDateTime::currentDateTime().offsetFromUtc();
+    m_today = dayOf(QDateTime::currentSecsSinceEpoch());
+    const qint64 since = (m_today - Days + 1) * 86400 - m_utcOffset;
+
+    //货品槽位
+    m_slots.clear();
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.exec("SELECT id FROM products WHERE deleted = 0");
+    while (query.next()) m_slots.insert(query.value(0).toInt(), m_slots.size());
+    const int n = m_slots.size();
+
+    //最近 90 天的出库记录读成三列（仓库间调拨不算消耗）
+    QVector<int> slotCol, dayCol, countCol;
+    query.prepare("SELECT product_id, timestamp, count FROM records "
+                  "WHERE type = 0 AND peer_location_id = 0 AND timestamp >= :since");
+    query.bindValue(":since", since);
+    if (!query.exec()) qDebug() << "Load Outbound Records Error:" << query.lastError();
+    while (query.next()) {
+        auto it = m_slots.constFind(query.value(0).toInt());
+        if (it == m_slots.constEnd()) continue;
+        slotCol.append(it.value());
+        dayCol.append(int(dayOf(query.value(1).toLongLong()) % Days));
+        countCol.append(query.value(2).toInt());
+    }
+    const int m = slotCol.size();
+
+    //按槽位计数排序，每个货品的记录变成连续区间，后面可以无锁并行
+    QVector<int> begin(n + 1, 0);
+    for (int s : slotCol) begin[s + 1]++;
+    for (int i = 0; i < n; ++i) begin[i + 1] += begin[i];
+    QVector<int> sortedDay(m), sortedCount(m);
+    QVector<int> cursor = begin;
+    for (int i = 0; i < m; ++i) {
+        const int pos = cursor[slotCol.at(i)]++;
+        sortedDay[pos] = dayCol.at(i);
+        sortedCount[pos] = countCol.at(i);
+    }
+
+    m_daily = QVector<qint32>(n * Days, 0);
+    m_rate7 = QVector<float>(n, 0.0f);
+    m_rate30 = QVector<float>(n, 0.0f);
+    m_rate90 = QVector<float>(n, 0.0f);
+    m_smoothed = QVector<float>(n, 0.0f);
+
+    //按货品分块并行：每块只写自己的槽位
+    const int chunk = 1024;
+    QVector<int> chunks;
+    for (int i = 0; i < n; i += chunk) chunks.append(i);
+    QtConcurrent::blockingMap(chunks, [&](int first) {
+        const int last = qMin(first + chunk, n);
+        for (int s = first; s < last; ++s) {
+            qint32 *daily = m_daily.data() + qint64(s) * Days;
+            for (int i = begin.at(s); i < begin.at(s + 1); ++i)
+                daily[sortedDay.at(i)] += sortedCount.at(i);
+            computeRates(s);
+        }
+    });
+
+    timer.setRows(m);
+}
+
+void Forecaster::computeRates(int slot) {
+    //把环形槽整理成"今天在前"的顺序，再做几次连续累加
+    const qint32 *daily = m_daily.constData() + qint64(slot) * Days;
+    const int todayIdx = int(m_today % Days);
+    qint32 ordered[Days];
+    for (int k = 0; k <= todayIdx; ++k) ordered[k] = daily[todayIdx - k];
+    for (int k = todayIdx + 1; k < Days; ++k) ordered[k] = daily[todayIdx - k + Days];
+
+    qint64 sum7 = 0, sum30 = 0, sum90 = 0;
+    for (int k = 0; k < 7; ++k) sum7 += ordered[k];
+    sum30 = sum7;
+    for (int k = 7; k < 30; ++k) sum30 += ordered[k];
+    sum90 = sum30;
+    for (int k = 30; k < Days; ++k) sum90 += ordered[k];
+
+    float smoothed = float(sum90) / Days;
+    for (int k = Days - 1; k >= 0; --k)
+        smoothed = SmoothingAlpha * ordered[k] + (1.0f - SmoothingAlpha) * smoothed;
+
+    m_rate7[slot] = float(sum7) / 7;
+    m_rate30[slot] = float(sum30) / 30;
+    m_rate90[slot] = float(sum90) / Days;
+    m_smoothed[slot] = smoothed;
+}
+
+int Forecaster::slotFor(int productId) {
+    auto it = m_slots.constFind(productId);
+    if (it != m_slots.constEnd()) return it.value();
+
+    const int slot = m_slots.size();
+    m_slots.insert(productId, slot);
+    m_daily.resize(m_daily.size() + Days);
+    std::memset(m_daily.data() + qint64(slot) * Days, 0, Days * sizeof(qint32));
+    m_rate7.append(0.0f);
+    m_rate30.append(0.0f);
+    m_rate90.append(0.0f);
+    m_smoothed.append(0.0f);
+    return slot;
+}
+
+void Forecaster::rollTo(qint64 day) {
+    if (day <= m_today) return;
+
+    //清空新进入窗口的日期对应的槽（最多清一整圈）
+    const int n = m_slots.size();
+    const qint64 steps = qMin<qint64>(day - m_today, Days);
+    for (qint64 j = 1; j <= steps; ++j) {
+        const int idx = int((m_today + j) % Days);
+        for (int s = 0; s < n; ++s) m_daily[qint64(s) * Days + idx] = 0;
+    }
+    m_today = day;
+    for (int s = 0; s < n; ++s) computeRates(s);
+}
+
+void Forecaster::addOutbound(int productId, int count, qint64 timestamp) {
+    if (m_today == 0) return; // 尚未加载
+    const qint64 day = dayOf(timestamp);
+    rollTo(day);
+    if (day <= m_today - Days) return;
+
+    const int slot = slotFor(productId);
+    m_daily[qint64(slot) * Days + int(day % Days)] += count;
+    computeRates(slot);
+    Metrics::count("forecast_incremental_updates_total");
+}
+
+double Forecaster::rate7(int productId) const {
+    auto it = m_slots.constFind(productId);
+    return it == m_slots.constEnd() ? 0.0 : m_rate7.at(it.value());
+}
+
+double Forecaster::rate30(int productId) const {
+    auto it = m_slots.constFind(productId);
+    return it == m_slots.constEnd() ? 0.0 : m_rate30.at(it.value());
+}
+
+double Forecaster::rate90(int productId) const {
+    auto it = m_slots.constFind(productId);
+    return it == m_slots.constEnd() ? 0.0 : m_rate90.at(it.value());
+}
+
+double Forecaster::smoothedRate(int productId) const {
+    auto it = m_slots.constFind(productId);
+    return it == m_slots.constEnd() ? 0.0 : m_smoothed.at(it.value());
+}
+
+double Forecaster::daysUntilStockout(int productId, int quantity) const {
+    auto it = m_slots.constFind(productId);
+    if (it == m_slots.constEnd()) return -1;
+    //平滑速率为 0 时（近期无出库）退回 90 天平均
+    double rate = m_smoothed.at(it.value());
+    if (rate <= 0.0) rate = m_rate90.at(it.value());
+    if (rate <= 0.0) return -1;
+    return qMax(0, quantity) / rate;
+}
@@ -0,0 +1,53 @@
+#ifndef FORECASTER_H
+#define FORECASTER_H
+
+#include <QHash>
+#include <QVector>
+
+// 补货预测：按货品统计最近 90 天的每日出库量，计算 7/30/90 天平均出库速度
+// 和指数平滑后的日出库量，估算距离缺货的天数。
+//
+// 数据按列存放：每个货品占用 m_daily 中连续的 Days 个槽（按"天数 % Days"环形使用），
+// 速率存放在独立的数组中，计算时都是对连续内存的简单循环。
+// 全量加载时按货品分组并行计算；之后每笔出库只更新该货品的一个槽和速率。
+// 只在界面线程中使用。
+class Forecaster
+{
+public:
+    static const int Days = 90;
+
+    static Forecaster& instance();
+
+    void reload();                                         // 从出库记录重建
+    void addOutbound(int productId, int count, qint64 timestamp); // 出库后增量更新
+
+    // 日出库量（件/天）
+    double rate7(int productId) const;
+    double rate30(int productId) const;
+    double rate90(int productId) const;
+    double smoothedRate(int productId) const;             // 指数平滑（alpha = 0.2）
+
+    // 按当前库存估算可用天数，没有出库记录时返回 -1
+    double daysUntilStockout(int productId, int quantity) const;
+
+private:
+    Forecaster();
+    Forecaster(const Forecaster&) = delete;
+    Forecaster& operator=(const Forecaster&) = delete;
+
+    int slotFor(int productId);        // 不存在时分配新槽
+    void rollTo(qint64 day);           // 跨天时清理过期的槽
+    void computeRates(int slot);       // 重新计算一个货品的速率
+    qint64 dayOf(qint64 timestamp) const { return (timestamp + m_utcOffset) / 86400; }
+
+    QHash<int, int> m_slots;           // 货品ID -> 槽位
+    QVector<qint32> m_daily;           // 槽位 * Days，每日出库量
+    QVector<float> m_rate7;
+    QVector<float> m_rate30;
+    QVector<float> m_rate90;
+    QVector<float> m_smoothed;
+    qint64 m_today;                    // 当前统计到的日期（自纪元起的天数），0 表示尚未加载
+    qint64 m_utcOffset;                // 本地时区偏移，用于把时间戳换算成本地日期
+};
+
+#endif // FORECASTER_H
@@ -0,0 +1,224 @@
+#include "ingestserver.h"
+#include "dbmanager.h"
+#include "locationstock.h"
+#include "metrics.h"
+#include <QTcpSocket>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QVector>
+#include <QDebug>
+
+IngestServer::IngestServer(QObject *parent)
+    : QObject(parent)
+    , m_pendingMoves(0)
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(MaxDelayMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &IngestServer::flush);
+    connect(&m_server, &QTcpServer::newConnection, this, &IngestServer::onNewConnection);
+}
+
+bool IngestServer::start(const QString &token, quint16 port, const QHostAddress &address) {
+    if (m_server.isListening()) return true;
+    m_error.clear();
+    if (token.isEmpty()) {
+        m_error = "未设置连接令牌";
+        return false;
+    }
+    m_token = token;
+    if (!m_server.listen(address, port)) {
+        qDebug() << "Ingest Server Listen Error:" << m_server.errorString();
+        return false;
+    }
+    return true;
+}
+
+void IngestServer::stop() {
+    flush();
+    m_server.close();
+    const QList<QTcpSocket *> clients = m_clients; // 断开时会从 m_clients 中移除
+    for (QTcpSocket *socket : clients) socket->disconnectFromHost();
+}
+
+void IngestServer::onNewConnection() {
+    while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        m_clients.append(socket);
+        connect(socket, &QTcpSocket::readyRead, this, &IngestServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, &IngestServer::onDisconnected);
+        //限定时间内没有认证的连接直接断开
+        QTimer::singleShot(AuthTimeoutMs, socket, [this, socket] {
+            if (!m_authenticated.contains(socket)) socket->abort();
+        });
+        Metrics::count("ingest_connections_total");
+    }
+}
+
+//比较时不因第一个不同的字符提前返回，避免按响应时间逐字猜出令牌
+static bool sameToken(const QByteArray &a, const QByteArray &b) {
+    if (a.size() != b.size()) return false;
+    char diff = 0;
+    for (int i = 0; i < a.size(); ++i) diff |= a.at(i) ^ b.at(i);
+    return diff == 0;
+}
+
+bool IngestServer::authenticate(QTcpSocket *socket, const QByteArray &line) {
+    const QJsonObject request = QJsonDocument::fromJson(line).object();
+    QJsonObject response;
+    if (request.value("op").toString() == "auth"
+        && sameToken(request.value("token").toString().toUtf8(), m_token.toUtf8())) {
+        m_authenticated.insert(socket);
+        response["ok"] = true;
+    } else {
+        Metrics::count("ingest_auth_failures_total");
+        response["ok"] = false;
+        response["error"] = "认证失败";
+    }
+    if (request.contains("id")) response["id"] = request.value("id");
+    reply(socket, response);
+    return response.value("ok").toBool();
+}
+
+void IngestServer::onDisconnected() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (!socket) return;
+    m_clients.removeAll(socket);
+    m_authenticated.remove(socket);
+    //丢弃该连接还没处理的请求（出入库尚未执行，终端重连后会带同一幂等键重试）
+    for (int i = m_pending.size() - 1; i >= 0; --i) {
+        if (m_pending.at(i).socket != socket) continue;
+        if (m_pending.at(i).request.value("op").toString() == "move") m_pendingMoves--;
+        m_pending.removeAt(i);
+    }
+    socket->deleteLater();
+}
+
+void IngestServer::onReadyRead() {
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (!socket) return;
+
+    bool tooLong = false;
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.size() > MaxLineBytes) {
+            tooLong = true;
+            break;
+        }
+        if (line.isEmpty()) continue;
+        if (!m_authenticated.contains(socket)) {
+            if (!authenticate(socket, line)) {
+                socket->disconnectFromHost();
+                return;
+            }
+            continue;
+        }
+        enqueue(socket, line);
+    }
+    //超长的行（或迟迟不出现换行）视为协议错误
+    if (tooLong || socket->bytesAvailable() > MaxLineBytes) {
+        reply(socket, {{"ok", false}, {"error", "请求过长"}});
+        socket->disconnectFromHost();
+    }
+}
+
+void IngestServer::enqueue(QTcpSocket *socket, const QByteArray &line) {
+    Metrics::count("ingest_requests_total");
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
+    if (!doc.isObject()) {
+        //无法解析的行没有 id 可回，但仍要占一个位置保证响应顺序
+        m_pending.append({socket, QJsonObject{{"op", "invalid"}, {"error", parseError.errorString()}}});
+    } else {
+        m_pending.append({socket, doc.object()});
+        if (doc.object().value("op").toString() == "move") m_pendingMoves++;
+    }
+
+    if (m_pendingMoves >= MaxBatch) flush();
+    else if (!m_flushTimer.isActive()) m_flushTimer.start();
+}
+
+//处理当前排队的全部请求：出入库合并成一个事务，查询在提交之后执行，能看到本批的结果
+void IngestServer::flush() {
+    m_flushTimer.stop();
+    if (m_pending.isEmpty()) return;
+    ScopedTimer timer("ingest_flush");
+
+    QList<Pending> pending;
+    pending.swap(m_pending);
+    m_pendingMoves = 0;
+
+    QList<StockMovement> moves;
+    QVector<int> moveIndex(pending.size(), -1); // 请求 -> moves 下标
+    QVector<QString> invalid(pending.size());   // 参数错误，不进入事务
+
+    for (int i = 0; i < pending.size(); ++i) {
+        const QJsonObject &req = pending.at(i).request;
+        if (req.value("op").toString() != "move") continue;
+
+        StockMovement m;
+        m.productId = req.value("product_id").toInt(-1);
+        m.count = req.value("count").toInt(0);
+        m.isInbound = req.value("inbound").toBool(true);
+        m.remark = req.value("remark").toString();
+        m.locationId = req.value("location_id").toInt(DefaultLocationId);
+        m.requestKey = req.value("key").toString();
+        if (m.productId <= 0 || m.count <= 0) {
+            invalid[i] = "product_id 和 count 必须为正整数";
+            continue;
+        }
+        moveIndex[i] = moves.size();
+        moves.append(m);
+    }
+
+    QStringList results;
+    if (!moves.isEmpty()) results = DbManager::instance().adjustStockBatch(moves);
+    timer.setRows(moves.size());
+
+    int applied = 0;
+    for (int i = 0; i < pending.size(); ++i) {
+        const Pending &p = pending.at(i);
+        const QString op = p.request.value("op").toString();
+        QJsonObject response;
+
+        if (op == "move") {
+            const QString error = moveIndex.at(i) >= 0 ? results.value(moveIndex.at(i)) : invalid.at(i);
+            response["ok"] = error.isEmpty();
+            if (!error.isEmpty()) response["error"] = error;
+            else applied++;
+        } else if (op == "invalid") {
+            response["ok"] = false;
+            response["error"] = "无法解析的请求: " + p.request.value("error").toString();
+        } else {
+            response = handleQuery(p.request);
+        }
+
+        if (p.request.contains("id")) response["id"] = p.request.value("id");
+        reply(p.socket, response);
+    }
+
+    if (applied > 0) emit movementsApplied(applied);
+}
+
+QJsonObject IngestServer::handleQuery(const QJsonObject &request) {
+    const QString op = request.value("op").toString();
+    if (op == "ping") return {{"ok", true}};
+
+    if (op == "stock") {
+        const int productId = request.value("product_id").toInt(-1);
+        Product p = DbManager::instance().getProductById(productId);
+        if (p.id == -1) return {{"ok", false}, {"error", "货品不存在"}};
+
+        QJsonObject locations;
+        for (const Location &l : LocationStock::instance().locations())
+            locations[QString::number(l.id)] = LocationStock::instance().quantity(p.id, l.id);
+        return {{"ok", true}, {"quantity", p.quantity}, {"min_stock", p.minStock}, {"locations", locations}};
+    }
+
+    return {{"ok", false}, {"error", "未知操作: " + op}};
+}
+
+void IngestServer::reply(QTcpSocket *socket, const QJsonObject &response) {
+    QByteArray line = QJsonDocument(response).toJson(QJsonDocument::Compact);
+    line += '\n';
+    socket->write(line);
+}
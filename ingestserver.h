@@ -0,0 +1,83 @@
+#ifndef INGESTSERVER_H
+#define INGESTSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTimer>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QHostAddress>
+
+class QTcpSocket;
+
+// 终端采集服务：手持终端通过 TCP 提交出入库和查询
+//
+// 协议为 JSON Lines，每行一个请求，每个请求对应一行响应（按请求顺序返回）。
+// 连接后的第一行必须是认证请求，令牌不对（或先发了别的请求）时回一行错误并断开：
+//   {"op":"auth","token":"..."}
+// 之后:
+//   {"id":1,"op":"move","product_id":3,"count":5,"inbound":true,"location_id":1,"key":"T01-000123","remark":"..."}
+//   {"id":2,"op":"stock","product_id":3}
+//   {"id":3,"op":"ping"}
+// 响应: {"id":1,"ok":true} / {"id":1,"ok":false,"error":"库存不足..."}
+//
+// 客户端可以不等响应连续发送（流水线）。各连接收到的请求先排队，
+// 攒满 MaxBatch 条或等待 MaxDelayMs 后统一处理：全部出入库合并成一次
+// DbManager::adjustStockBatch 事务，再按各连接的请求顺序写回结果。
+// 运行在界面线程（DbManager 的默认连接所在线程）。
+class IngestServer : public QObject
+{
+    Q_OBJECT
+public:
+    static const quint16 DefaultPort = 7070;
+    static const int MaxBatch = 500;        // 单个事务最多合并的出入库条数
+    static const int MaxDelayMs = 2;        // 首个请求到达后最多等待多久再处理
+    static const int MaxLineBytes = 65536;  // 单行请求上限，超过视为协议错误并断开
+    static const int AuthTimeoutMs = 5000;  // 连接后多久内必须完成认证
+
+    explicit IngestServer(QObject *parent = nullptr);
+
+    // 令牌不能为空；地址默认只监听本机，供局域网终端使用时需显式指定
+    bool start(const QString &token, quint16 port = DefaultPort,
+               const QHostAddress &address = QHostAddress(QHostAddress::LocalHost));
+    void stop();
+    bool isListening() const { return m_server.isListening(); }
+    quint16 port() const { return m_server.serverPort(); }
+    QString errorString() const { return m_error.isEmpty() ? m_server.errorString() : m_error; }
+    int connectionCount() const { return m_clients.size(); }
+
+signals:
+    // 一批出入库已提交（count 为成功条数），界面据此刷新
+    void movementsApplied(int count);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void flush();
+
+private:
+    struct Pending {
+        QTcpSocket *socket;
+        QJsonObject request;
+    };
+
+    bool authenticate(QTcpSocket *socket, const QByteArray &line);
+    void enqueue(QTcpSocket *socket, const QByteArray &line);
+    QJsonObject handleQuery(const QJsonObject &request);
+    static void reply(QTcpSocket *socket, const QJsonObject &response);
+
+    QTcpServer m_server;
+    QTimer m_flushTimer;
+    QList<QTcpSocket *> m_clients;
+    QSet<QTcpSocket *> m_authenticated;
+    QString m_token;
+    QString m_error;
+    QList<Pending> m_pending; // 所有连接按到达顺序排队的请求
+    int m_pendingMoves;
+};
+
+#endif // INGESTSERVER_H
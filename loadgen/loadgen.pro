@@ -0,0 +1,14 @@
+# 终端采集服务压测工具（独立控制台程序）
+# 用法: 先在主程序中开启"数据 → 终端采集服务"，然后运行
+#       warehouse_loadgen --token <令牌> --connections 8 --requests 100000 --pipeline 64
+
+QT       += core network
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = warehouse_loadgen
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,188 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTcpSocket>
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QDebug>
+#include <algorithm>
+#include <memory>
+
+// 一个终端连接：保持 pipeline 个请求在途，收到响应后补发
+struct Client {
+    QTcpSocket socket;
+    QByteArray buffer;
+    QHash<qint64, qint64> inFlight; // 请求 id -> 发送时间 (ns)
+    int sent = 0;
+    int quota = 0;                  // 该连接需要发送的请求数
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("终端采集服务压测工具");
+    parser.addHelpOption();
+    QCommandLineOption hostOpt("host", "服务地址", "host", "127.0.0.1");
+    QCommandLineOption portOpt("port", "服务端口", "port", "7070");
+    QCommandLineOption connOpt("connections", "并发连接数", "n", "8");
+    QCommandLineOption reqOpt("requests", "请求总数", "n", "100000");
+    QCommandLineOption pipeOpt("pipeline", "每个连接同时在途的请求数", "n", "64");
+    QCommandLineOption prodOpt("products", "随机货品 ID 范围 1..n", "n", "1000");
+    QCommandLineOption queryOpt("query-ratio", "库存查询占比 (0~1)", "r", "0");
+    QCommandLineOption retryOpt("retry-ratio", "重发上一条幂等键的占比 (0~1)，模拟超时重试", "r", "0");
+    QCommandLineOption tokenOpt("token", "连接令牌（默认取环境变量 WAREHOUSE_INGEST_TOKEN）", "token",
+                                qEnvironmentVariable("WAREHOUSE_INGEST_TOKEN"));
+    QCommandLineOption outOpt("out", "结果 JSON 文件（可选）", "file");
+    parser.addOptions({hostOpt, portOpt, connOpt, reqOpt, pipeOpt, prodOpt, queryOpt, retryOpt, tokenOpt, outOpt});
+    parser.process(app);
+
+    const QString host = parser.value(hostOpt);
+    const quint16 port = quint16(parser.value(portOpt).toUInt());
+    const int connections = qMax(1, parser.value(connOpt).toInt());
+    const int requests = qMax(1, parser.value(reqOpt).toInt());
+    const int pipeline = qMax(1, parser.value(pipeOpt).toInt());
+    const int products = qMax(1, parser.value(prodOpt).toInt());
+    const double queryRatio = parser.value(queryOpt).toDouble();
+    const double retryRatio = parser.value(retryOpt).toDouble();
+    //认证请求使用 id 0（业务请求从 1 开始），其响应不计入统计
+    const QByteArray authLine = QJsonDocument(QJsonObject{{"id", 0}, {"op", "auth"}, {"token", parser.value(tokenOpt)}})
+                                    .toJson(QJsonDocument::Compact) + '\n';
+
+    QRandomGenerator rng(20240601);
+    QElapsedTimer clock;
+    QVector<double> latenciesUs;
+    latenciesUs.reserve(requests);
+    qint64 nextId = 1;
+    int okCount = 0, failCount = 0, done = 0, connected = 0;
+    QString lastKey;
+
+    //生成一行请求：入库/出库各半，按比例混入查询和重试
+    auto makeRequest = [&](qint64 id) {
+        QJsonObject req;
+        req["id"] = id;
+        const int productId = int(rng.bounded(products)) + 1;
+        if (rng.generateDouble() < queryRatio) {
+            req["op"] = "stock";
+            req["product_id"] = productId;
+        } else {
+            req["op"] = "move";
+            req["product_id"] = productId;
+            req["count"] = 1;
+            req["inbound"] = rng.bounded(2) == 0;
+            req["remark"] = "loadgen";
+            if (!lastKey.isEmpty() && rng.generateDouble() < retryRatio) {
+                req["key"] = lastKey;
+            } else {
+                lastKey = QString("lg-%1-%2").arg(QCoreApplication::applicationPid()).arg(id);
+                req["key"] = lastKey;
+            }
+        }
+        return QJsonDocument(req).toJson(QJsonDocument::Compact) + '\n';
+    };
+
+    std::vector<std::unique_ptr<Client>> clients;
+
+    auto fill = [&](Client *c) {
+        QByteArray out;
+        while (c->inFlight.size() < pipeline && c->sent < c->quota) {
+            const qint64 id = nextId++;
+            c->inFlight.insert(id, clock.nsecsElapsed());
+            out += makeRequest(id);
+            c->sent++;
+        }
+        if (!out.isEmpty()) c->socket.write(out);
+    };
+
+    auto finish = [&]() {
+        const double seconds = clock.nsecsElapsed() / 1e9;
+        std::sort(latenciesUs.begin(), latenciesUs.end());
+        auto pct = [&](double q) {
+            return latenciesUs.isEmpty() ? 0.0 : latenciesUs.at(qMin(latenciesUs.size() - 1, int(q * latenciesUs.size())));
+        };
+
+        qInfo().noquote() << QString("requests %1  ok %2  failed %3  in %4 s")
+                                 .arg(done).arg(okCount).arg(failCount).arg(seconds, 0, 'f', 2);
+        qInfo().noquote() << QString("throughput %1 req/s").arg(done / seconds, 0, 'f', 0);
+        qInfo().noquote() << QString("latency p50 %1 ms  p95 %2 ms  p99 %3 ms  max %4 ms")
+                                 .arg(pct(0.50) / 1000.0, 0, 'f', 2).arg(pct(0.95) / 1000.0, 0, 'f', 2)
+                                 .arg(pct(0.99) / 1000.0, 0, 'f', 2)
+                                 .arg((latenciesUs.isEmpty() ? 0.0 : latenciesUs.last()) / 1000.0, 0, 'f', 2);
+
+        if (parser.isSet(outOpt)) {
+            QJsonObject root;
+            root["connections"] = connections;
+            root["pipeline"] = pipeline;
+            root["requests"] = done;
+            root["ok"] = okCount;
+            root["failed"] = failCount;
+            root["seconds"] = seconds;
+            root["requests_per_sec"] = done / seconds;
+            root["p50_ms"] = pct(0.50) / 1000.0;
+            root["p95_ms"] = pct(0.95) / 1000.0;
+            root["p99_ms"] = pct(0.99) / 1000.0;
+            QFile file(parser.value(outOpt));
+            if (file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+                file.write(QJsonDocument(root).toJson());
+        }
+        QCoreApplication::exit(failCount > 0 && okCount == 0 ? 1 : 0);
+    };
+
+    for (int i = 0; i < connections; ++i) {
+        clients.emplace_back(new Client);
+        Client *c = clients.back().get();
+        c->quota = requests / connections + (i < requests % connections ? 1 : 0);
+
+        QObject::connect(&c->socket, &QTcpSocket::connected, [&, c] {
+            c->socket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            c->socket.write(authLine);
+            //全部连接建立后再开始计时
+            if (++connected < connections) return;
+            clock.start();
+            for (auto &client : clients) fill(client.get());
+        });
+
+        QObject::connect(&c->socket, &QTcpSocket::readyRead, [&, c] {
+            c->buffer += c->socket.readAll();
+            int start = 0;
+            int end;
+            while ((end = c->buffer.indexOf('\n', start)) >= 0) {
+                const QJsonObject resp = QJsonDocument::fromJson(c->buffer.mid(start, end - start)).object();
+                start = end + 1;
+                const qint64 id = resp.value("id").toVariant().toLongLong();
+                if (id == 0) {
+                    if (resp.value("ok").toBool()) continue;
+                    qCritical().noquote() << "认证失败，请用 --token 指定连接令牌";
+                    QCoreApplication::exit(2);
+                    return;
+                }
+                auto it = c->inFlight.find(id);
+                if (it != c->inFlight.end()) {
+                    latenciesUs.append((clock.nsecsElapsed() - it.value()) / 1000.0);
+                    c->inFlight.erase(it);
+                }
+                if (resp.value("ok").toBool()) okCount++;
+                else failCount++;
+                done++;
+            }
+            c->buffer.remove(0, start);
+
+            fill(c);
+            if (done >= requests) finish();
+        });
+
+        QObject::connect(&c->socket, &QTcpSocket::errorOccurred, [&, c](QAbstractSocket::SocketError) {
+            qCritical().noquote() << "连接错误:" << c->socket.errorString();
+            QCoreApplication::exit(2);
+        });
+
+        c->socket.connectToHost(host, port);
+    }
+
+    return app.exec();
+}
@@ -0,0 +1,90 @@
+#include "locationstock.h"
+#include "metrics.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+LocationStock::LocationStock() : m_loaded(false) {}
+
+LocationStock& LocationStock::instance() {
+    static LocationStock instance;
+    return instance;
+}
+
+void LocationStock::ensureLoaded() {
+    if (m_loaded) return;
+    ScopedTimer timer("location_stock_reload");
+
+    m_locations.clear();
+    m_quantity.clear();
+    m_price.clear();
+    m_aggregates.clear();
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.exec("SELECT id, code, name FROM locations ORDER BY id");
+    while (query.next()) {
+        Location l;
+        l.id = query.value(0).toInt();
+        l.code = query.value(1).toString();
+        l.name = query.value(2).toString();
+        m_locations.append(l);
+        m_aggregates.insert(l.id, Aggregate());
+    }
+
+    query.exec("SELECT id, price FROM products WHERE deleted = 0");
+    while (query.next()) m_price.insert(query.value(0).toInt(), query.value(1).toDouble());
+
+    //已删除货品的分仓行保留（恢复时还要用），但不计入汇总
+    if (!query.exec("SELECT s.product_id, s.location_id, s.quantity FROM stock_levels s "
+                    "JOIN products p ON p.id = s.product_id WHERE p.deleted = 0"))
+        qDebug() << "Load Stock Levels Error:" << query.lastError();
+    while (query.next()) {
+        const int productId = query.value(0).toInt();
+        const int locationId = query.value(1).toInt();
+        const int qty = query.value(2).toInt();
+        m_quantity.insert(key(productId, locationId), qty);
+
+        Aggregate &a = m_aggregates[locationId];
+        a.units += qty;
+        a.value += qty * m_price.value(productId);
+        if (qty > 0) a.skuCount++;
+    }
+
+    m_loaded = true;
+    timer.setRows(m_quantity.size());
+}
+
+void LocationStock::update(int productId, int locationId, int newQuantity) {
+    //尚未加载时无需维护，首次使用时会读到最新数据
+    if (!m_loaded) return;
+
+    int &qty = m_quantity[key(productId, locationId)];
+    const int delta = newQuantity - qty;
+    Aggregate &a = m_aggregates[locationId];
+    a.units += delta;
+    a.value += delta * m_price.value(productId);
+    if (qty <= 0 && newQuantity > 0) a.skuCount++;
+    else if (qty > 0 && newQuantity <= 0) a.skuCount--;
+    qty = newQuantity;
+}
+
+int LocationStock::quantity(int productId, int locationId) {
+    ensureLoaded();
+    return m_quantity.value(key(productId, locationId), 0);
+}
+
+QList<Location> LocationStock::locations() {
+    ensureLoaded();
+    return m_locations;
+}
+
+QList<LocationSummary> LocationStock::summaries() {
+    ensureLoaded();
+    QList<LocationSummary> list;
+    for (const Location &l : m_locations) {
+        const Aggregate a = m_aggregates.value(l.id);
+        list.append({l.id, l.code, l.name, a.units, a.skuCount, a.value});
+    }
+    return list;
+}
@@ -0,0 +1,59 @@
+#ifndef LOCATIONSTOCK_H
+#define LOCATIONSTOCK_H
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include "warehousedata.h"
+
+// 某个仓库的库存汇总
+struct LocationSummary {
+    int locationId;
+    QString code;
+    QString name;
+    qint64 units;   // 库存总量
+    int skuCount;   // 有库存的货品种数
+    double value;   // 货值（按当前单价）
+};
+
+// 分仓库存：按 (货品, 仓库) 保存数量，并增量维护每个仓库的汇总
+// 首次使用时从 stock_levels 加载一次；之后由 DbManager 在出入库 / 调拨提交后
+// 传入该仓库的新数量，只调整对应仓库的汇总，不再重新统计整张表。
+// 货品单价或仓库列表变化后整体失效，下次使用时重新加载。
+// 只在界面线程中使用。
+class LocationStock
+{
+public:
+    static LocationStock& instance();
+
+    void update(int productId, int locationId, int newQuantity); // 某货品在某仓库的数量变化后调用
+    void invalidate() { m_loaded = false; }
+
+    int quantity(int productId, int locationId);
+    QList<Location> locations();
+    QList<LocationSummary> summaries();
+
+private:
+    LocationStock();
+    LocationStock(const LocationStock&) = delete;
+    LocationStock& operator=(const LocationStock&) = delete;
+
+    struct Aggregate {
+        qint64 units = 0;
+        int skuCount = 0;
+        double value = 0;
+    };
+
+    static quint64 key(int productId, int locationId) {
+        return (quint64(quint32(productId)) << 32) | quint32(locationId);
+    }
+    void ensureLoaded();
+
+    bool m_loaded;
+    QList<Location> m_locations;
+    QHash<quint64, int> m_quantity;     // (货品, 仓库) -> 数量
+    QHash<int, double> m_price;         // 货品 -> 单价
+    QHash<int, Aggregate> m_aggregates; // 仓库 -> 汇总
+};
+
+#endif // LOCATIONSTOCK_H
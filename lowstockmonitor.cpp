@@ -0,0 +1,42 @@
+#include "lowstockmonitor.h"
+#include "metrics.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+LowStockMonitor::LowStockMonitor(QObject *parent) : QObject(parent) {}
+
+LowStockMonitor& LowStockMonitor::instance() {
+    static LowStockMonitor instance;
+    return instance;
+}
+
+void LowStockMonitor::reload() {
+    ScopedTimer timer("lowstock_reload");
+    //WHERE 条件与部分索引一致，SQLite 只扫描索引中的低库存货品
+    QSqlQuery query;
+    if (!query.exec("SELECT id FROM products WHERE quantity < min_stock AND deleted = 0")) {
+        qDebug() << "Load Low Stock Error:" << query.lastError();
+        return;
+    }
+    m_low.clear();
+    while (query.next()) m_low.insert(query.value(0).toInt());
+    timer.setRows(m_low.size());
+    emit reloaded();
+}
+
+void LowStockMonitor::update(int productId, int quantity, int minStock) {
+    const bool below = quantity < minStock;
+    const bool wasBelow = m_low.contains(productId);
+    if (below == wasBelow) return;
+
+    if (below) m_low.insert(productId);
+    else m_low.remove(productId);
+    Metrics::count("lowstock_crossings_total");
+    emit thresholdCrossed(productId, below);
+}
+
+void LowStockMonitor::remove(int productId) {
+    if (m_low.remove(productId))
+        emit thresholdCrossed(productId, false);
+}
@@ -0,0 +1,37 @@
+#ifndef LOWSTOCKMONITOR_H
+#define LOWSTOCKMONITOR_H
+
+#include <QObject>
+#include <QSet>
+
+// 低库存监控：维护"当前库存 < 安全库存"的货品集合
+// 启动时通过部分索引 idx_products_low_stock 加载一次，之后由 DbManager 在每次
+// 出入库 / 修改货品后以 O(1) 增量更新，不再需要扫描全部货品。
+// 只在界面线程中使用（DbManager 的默认连接同样属于界面线程）。
+class LowStockMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    static LowStockMonitor& instance();
+
+    void reload();                                          // 从数据库重建集合
+    void update(int productId, int quantity, int minStock); // 货品库存或阈值变化后调用
+    void remove(int productId);                             // 货品被删除
+
+    bool isLow(int productId) const { return m_low.contains(productId); }
+    QSet<int> lowProducts() const { return m_low; }
+    int count() const { return m_low.size(); }
+
+signals:
+    // 货品越过安全库存线（below=true 表示跌破，false 表示恢复）
+    void thresholdCrossed(int productId, bool below);
+    // 集合被整体重建
+    void reloaded();
+
+private:
+    explicit LowStockMonitor(QObject *parent = nullptr);
+
+    QSet<int> m_low;
+};
+
+#endif // LOWSTOCKMONITOR_H
@@ -1,10 +1,15 @@
 #include "mainwindow.h"
 #include <QApplication>
+#include "metrics.h"
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
 
+    //设置环境变量 WAREHOUSE_METRICS=1 可在启动时就开启性能指标采集
+    if (qEnvironmentVariableIntValue("WAREHOUSE_METRICS") > 0)
+        Metrics::setEnabled(true);
+
     //设置全局样式
     a.setStyleSheet(R"(
         QWidget { font-size: 14px; font-family: "Segoe UI", "Microsoft YaHei"; }
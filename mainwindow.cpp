@@ -1,18 +1,47 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "dbmanager.h"
+#include "lowstockmonitor.h"
+#include "forecaster.h"
+#include "locationstock.h"
+#include "requestkeyfilter.h"
+#include "timelinemodel.h"
+#include "metrics.h"
+#include "undocommands.h"
+#include "datasnapshot.h"
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QFile>
 #include <QInputDialog>
 #include <QFormLayout>
 #include <QTimer>
 #include <QDialogButtonBox>
+#include <QMenuBar>
+#include <QDateTimeEdit>
+#include <QElapsedTimer>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QVBoxLayout>
+#include <QCloseEvent>
+#include <QApplication>
+#include <QAbstractItemDelegate>
+#include <QRandomGenerator>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
     , m_progressDlg(nullptr)
+    , m_metricsDock(nullptr)
+    , m_lowStockLabel(nullptr)
+    , m_ingestServer(nullptr)
+    , m_ingestAction(nullptr)
+    , m_ingestRefreshTimer(nullptr)
+    , m_undoStack(nullptr)
+    , m_recordSearchTimer(nullptr)
+    , m_comboDirty(true)
 {
+    m_startupTimer.start();
+    m_productModel = nullptr;
     ui->setupUi(this);
 
     //初始化数据库
@@ -27,9 +56,9 @@ MainWindow::MainWindow(QWidget *parent)
     m_recordModel = new RecordModel(this);
 
     //设置 ProxyModel
-    m_proxyModel = new QSortFilterProxyModel(this);
+    m_proxyModel = new ProductFilterProxy(this);
     m_proxyModel->setSourceModel(m_productModel);
-    m_proxyModel->setFilterKeyColumn(2); // 默认搜索"名称"列 (第2列)
+    m_proxyModel->setFilterKeyColumn(ProductModel::ColName); // 默认搜索"名称"列
     m_proxyModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
 
     //绑定 View
@@ -38,20 +67,60 @@ MainWindow::MainWindow(QWidget *parent)
 
     //绑定信号槽
     setupUiLogic();
+    setupMenus();
 
-    //初始加载
-    m_productModel->reload();
-    refreshComboList();
+    //启动时只做必要的轻量工作：低库存集合走部分索引，库存表先显示上次退出时的首屏缓存，
+    //完整的货品列表、补货预测和检查点在窗口显示之后再加载（见 deferredStartup）
+    LowStockMonitor::instance().reload();
+    m_productModel->loadCache(firstScreenCachePath());
+    QTimer::singleShot(0, this, &MainWindow::deferredStartup);
 
     //状态栏
+    m_lowStockLabel = new QLabel(this);
+    ui->statusbar->addPermanentWidget(m_lowStockLabel);
+    updateLowStockLabel();
     ui->statusbar->showMessage("系统就绪");
+
+    //设置环境变量 WAREHOUSE_INGEST_PORT 可在启动时就开启终端采集服务
+    if (qEnvironmentVariableIsSet("WAREHOUSE_INGEST_PORT"))
+        m_ingestAction->setChecked(true);
 }
 
 MainWindow::~MainWindow()
 {
+    if (m_productModel && !m_productModel->isLoading())
+        m_productModel->saveCache(firstScreenCachePath());
     delete ui;
 }
 
+QString MainWindow::firstScreenCachePath() {
+    return DbManager::databasePath() + ".firstscreen";
+}
+
+void MainWindow::deferredStartup() {
+    if (Metrics::enabled())
+        Metrics::instance().observe("startup_window_shown", m_startupTimer.nsecsElapsed(), 0);
+
+    //货品列表在后台线程分页读取，先开始，与下面的计算重叠
+    connect(m_productModel, &ProductModel::loadFinished, this, [this] {
+        if (!m_startupTimer.isValid()) return; // 只统计启动时的第一次加载
+        if (Metrics::enabled())
+            Metrics::instance().observe("startup_products_loaded", m_startupTimer.nsecsElapsed(),
+                                        m_productModel->rowCount());
+        m_startupTimer.invalidate();
+    });
+    m_productModel->reloadAsync();
+
+    //每天保留一个库存检查点，历史库存查询只需回放检查点之后的记录
+    DbManager::instance().ensureDailyCheckpoint();
+    QTimer *checkpointTimer = new QTimer(this);
+    connect(checkpointTimer, &QTimer::timeout, this, [] { DbManager::instance().ensureDailyCheckpoint(); });
+    checkpointTimer->start(3600 * 1000);
+
+    Forecaster::instance().reload();
+    m_productModel->refreshForecast();
+}
+
 void MainWindow::setupUiLogic() {
     //标签页切换
     connect(ui->tabWidget, &QTabWidget::currentChanged, this, &MainWindow::onTabChanged);
@@ -61,6 +130,22 @@ void MainWindow::setupUiLogic() {
     connect(ui->btnStockExport, &QPushButton::clicked, this, &MainWindow::onStockExport);
     connect(ui->btnStockImport, &QPushButton::clicked, this, &MainWindow::onStockImport);
     connect(ui->editSearch, &QLineEdit::textChanged, this, &MainWindow::onSearchStock);
+    connect(ui->checkLowStock, &QCheckBox::toggled, this, &MainWindow::onLowStockOnly);
+    connect(ui->tableStock, &QTableView::doubleClicked, this, &MainWindow::onStockDoubleClicked);
+    //双击留给出入库流水，单击已选中的单元格、F2 或直接输入开始编辑
+    ui->tableStock->setEditTriggers(QAbstractItemView::SelectedClicked | QAbstractItemView::EditKeyPressed
+                                    | QAbstractItemView::AnyKeyPressed);
+    connect(m_productModel, &ProductModel::pendingChanged, this, &MainWindow::onPendingEditsChanged);
+    connect(m_productModel, &QAbstractItemModel::modelReset, this, &MainWindow::markComboDirty);
+    connect(m_productModel, &ProductModel::loadFinished, this, &MainWindow::markComboDirty);
+    //货品列表重新加载后（新增、修改），搜索结果按新的数据重新计算
+    connect(m_productModel, &QAbstractItemModel::modelReset, this, [this]() {
+        if (!ui->editSearch->text().isEmpty()) onSearchStock(ui->editSearch->text());
+    });
+
+    //低库存提醒
+    connect(&LowStockMonitor::instance(), &LowStockMonitor::thresholdCrossed, this, &MainWindow::onThresholdCrossed);
+    connect(&LowStockMonitor::instance(), &LowStockMonitor::reloaded, this, &MainWindow::updateLowStockLabel);
 
     //操作页
     connect(ui->btnSubmit, &QPushButton::clicked, this, &MainWindow::onSubmitOperation);
@@ -68,11 +153,87 @@ void MainWindow::setupUiLogic() {
     //记录页
     connect(ui->btnRecordExport, &QPushButton::clicked, this, &MainWindow::onRecordExport);
     connect(ui->btnRefreshRecord, &QPushButton::clicked, this, &MainWindow::onRefreshRecords);
+    //输入停顿 300ms 后再搜索，避免每个字符都查一次
+    m_recordSearchTimer = new QTimer(this);
+    m_recordSearchTimer->setSingleShot(true);
+    m_recordSearchTimer->setInterval(300);
+    connect(ui->editRecordSearch, &QLineEdit::textChanged, m_recordSearchTimer, QOverload<>::of(&QTimer::start));
+    connect(m_recordSearchTimer, &QTimer::timeout, this, &MainWindow::onSearchRecords);
+}
+
+void MainWindow::setupMenus() {
+    //性能指标面板，默认隐藏，从"视图"菜单打开
+    m_metricsDock = new MetricsDock(this);
+    addDockWidget(Qt::RightDockWidgetArea, m_metricsDock);
+    m_metricsDock->hide();
+
+    QMenu *dataMenu = ui->menubar->addMenu("数据");
+    dataMenu->addAction("导出二进制快照...", this, &MainWindow::onSnapshotExport);
+    dataMenu->addAction("从快照恢复...", this, &MainWindow::onSnapshotImport);
+    dataMenu->addAction("备份数据库...", this, &MainWindow::onBackup);
+    dataMenu->addAction("从备份恢复...", this, &MainWindow::onRestore);
+    dataMenu->addSeparator();
+    dataMenu->addAction("新增仓库...", this, &MainWindow::onAddLocation);
+    dataMenu->addAction("库存调拨...", this, &MainWindow::onTransferStock);
+    dataMenu->addSeparator();
+    m_ingestAction = dataMenu->addAction("终端采集服务");
+    m_ingestAction->setCheckable(true);
+    connect(m_ingestAction, &QAction::toggled, this, &MainWindow::onToggleIngestServer);
+    dataMenu->addSeparator();
+    dataMenu->addAction("历史库存查询...", this, &MainWindow::onStockAtTime);
+
+    //编辑：撤销 / 重做，修改和删除货品（也可在库存表右键）
+    m_undoStack = new QUndoStack(this);
+    m_undoStack->setUndoLimit(200);
+    QMenu *editMenu = ui->menubar->addMenu("编辑");
+    QAction *undoAction = editMenu->addAction("撤销", this, &MainWindow::onUndo);
+    undoAction->setShortcut(QKeySequence::Undo);
+    undoAction->setEnabled(false);
+    connect(m_undoStack, &QUndoStack::canUndoChanged, undoAction, &QAction::setEnabled);
+    connect(m_undoStack, &QUndoStack::undoTextChanged, undoAction, [undoAction](const QString &text) {
+        undoAction->setText(text.isEmpty() ? QString("撤销") : "撤销 " + text);
+    });
+    QAction *redoAction = editMenu->addAction("重做", this, &MainWindow::onRedo);
+    redoAction->setShortcut(QKeySequence::Redo);
+    redoAction->setEnabled(false);
+    connect(m_undoStack, &QUndoStack::canRedoChanged, redoAction, &QAction::setEnabled);
+    connect(m_undoStack, &QUndoStack::redoTextChanged, redoAction, [redoAction](const QString &text) {
+        redoAction->setText(text.isEmpty() ? QString("重做") : "重做 " + text);
+    });
+    editMenu->addSeparator();
+    QAction *editAction = editMenu->addAction("修改货品...", this, &MainWindow::onEditProduct);
+    QAction *deleteAction = editMenu->addAction("删除货品", this, &MainWindow::onDeleteProduct);
+    QAction *bulkPriceAction = editMenu->addAction("批量调价...", this, &MainWindow::onBulkPrice);
+    ui->tableStock->setContextMenuPolicy(Qt::ActionsContextMenu);
+    ui->tableStock->addAction(editAction);
+    ui->tableStock->addAction(deleteAction);
+    ui->tableStock->addAction(bulkPriceAction);
+
+    //库存表里的直接修改先暂存，保存时整批一次提交
+    editMenu->addSeparator();
+    QAction *saveAction = editMenu->addAction("保存修改", this, &MainWindow::onSaveEdits);
+    saveAction->setShortcut(QKeySequence::Save);
+    saveAction->setEnabled(false);
+    QAction *revertAction = editMenu->addAction("放弃修改", this, &MainWindow::onRevertEdits);
+    revertAction->setEnabled(false);
+    connect(m_productModel, &ProductModel::pendingChanged, saveAction, [saveAction, revertAction](int count) {
+        saveAction->setEnabled(count > 0);
+        revertAction->setEnabled(count > 0);
+    });
+
+    QMenu *reportMenu = ui->menubar->addMenu("报表");
+    reportMenu->addAction("库存货值（按分类）", this, &MainWindow::onReportStockValue);
+    reportMenu->addAction("出入库汇总...", this, &MainWindow::onReportMovements);
+    reportMenu->addAction("出入库排行...", this, &MainWindow::onReportTopMovers);
+    reportMenu->addAction("各仓库库存汇总", this, &MainWindow::onReportLocations);
+
+    QMenu *viewMenu = ui->menubar->addMenu("视图");
+    viewMenu->addAction(m_metricsDock->toggleViewAction());
 }
 
 void MainWindow::onTabChanged(int index) {
-    //切换到"出入库操作"(index=1)时，刷新一下下拉框，防止刚加了货品这里没显示
-    if (index == 1) {
+    //切换到"出入库操作"(index=1)时，货品有变化才重建下拉框（启动时不构建，首次打开时才构建）
+    if (index == 1 && m_comboDirty) {
         refreshComboList();
     }
     //切换到"历史记录"(index=2)时，刷新列表
@@ -81,34 +242,112 @@ void MainWindow::onTabChanged(int index) {
     }
 }
 
+//下拉框直接取自库存表的 Model，不再单独查询一遍全部货品
 void MainWindow::refreshComboList() {
+    m_comboDirty = false;
     ui->comboProduct->clear();
-    QList<Product> list = DbManager::instance().getAllProducts();
-    for (const Product &p : list) {
+    for (int row = 0; row < m_productModel->rowCount(); ++row) {
+        const Product p = m_productModel->getProduct(row);
         ui->comboProduct->addItem(p.displayText(), QVariant(p.id));
     }
+    fillLocationCombo(ui->comboLocation);
+}
+
+void MainWindow::markComboDirty() {
+    m_comboDirty = true;
+    if (ui->tabWidget->currentIndex() == 1 && !m_productModel->isLoading())
+        refreshComboList();
+}
+
+void MainWindow::fillLocationCombo(QComboBox *combo) {
+    const QVariant current = combo->currentData();
+    combo->clear();
+    for (const Location &l : LocationStock::instance().locations())
+        combo->addItem(l.code + " - " + l.name, QVariant(l.id));
+    int index = combo->findData(current);
+    if (index >= 0) combo->setCurrentIndex(index);
 }
 
+//有全文索引时按编号、名称、分类搜索；关键词太短或没有索引时退回名称列的子串过滤
 void MainWindow::onSearchStock(const QString &text) {
-    m_proxyModel->setFilterFixedString(text);
+    QSet<int> ids;
+    if (!text.trimmed().isEmpty() && DbManager::instance().searchProductIds(text, &ids)) {
+        m_proxyModel->setFilterFixedString(QString());
+        m_proxyModel->setMatchedIds(ids);
+    } else {
+        m_proxyModel->clearMatchedIds();
+        m_proxyModel->setFilterFixedString(text);
+    }
 }
 
-//新增货品
-void MainWindow::onAddProduct() {
+void MainWindow::onLowStockOnly(bool on) {
+    m_proxyModel->setLowStockOnly(on);
+}
+
+void MainWindow::onThresholdCrossed(int productId, bool below) {
+    updateLowStockLabel();
+    if (!below) return;
+    Product p = DbManager::instance().getProductById(productId);
+    if (p.id != -1) {
+        ui->statusbar->showMessage(QString("库存预警：%1 当前库存 %2，低于安全库存 %3")
+                                       .arg(p.code + " " + p.name).arg(p.quantity).arg(p.minStock), 10000);
+    }
+}
+
+//货品流水：按需分页加载，记录很多的货品也能立即打开
+void MainWindow::onStockDoubleClicked(const QModelIndex &index) {
+    const int row = m_proxyModel->mapToSource(index).row();
+    const Product p = m_productModel->getProduct(row);
+    if (p.id <= 0) return;
+
     QDialog dlg(this);
-    dlg.setWindowTitle("新增货品");
+    dlg.setWindowTitle(QString("出入库流水 - %1 %2").arg(p.code, p.name));
+    dlg.resize(800, 600);
+    QVBoxLayout *layout = new QVBoxLayout(&dlg);
+    layout->addWidget(new QLabel(QString("当前库存: %1 %2    安全库存: %3")
+                                     .arg(p.quantity).arg(p.unit).arg(p.minStock)));
+
+    TimelineModel *model = new TimelineModel(&dlg);
+    QTableView *view = new QTableView();
+    //固定行高，视图不必逐行测量，滚动时只绘制可见行
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->verticalHeader()->hide();
+    view->horizontalHeader()->setStretchLastSection(true);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setModel(model);
+    model->setProduct(p.id, p.quantity);
+    layout->addWidget(view);
+
+    QDialogButtonBox *box = new QDialogButtonBox(QDialogButtonBox::Close);
+    layout->addWidget(box);
+    connect(box, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+    dlg.exec();
+}
+
+void MainWindow::updateLowStockLabel() {
+    if (m_lowStockLabel)
+        m_lowStockLabel->setText(QString("低库存货品: %1").arg(LowStockMonitor::instance().count()));
+}
+
+//货品资料对话框（新增和修改共用），确认且必填项不为空时返回 true
+bool MainWindow::productDialog(const QString &title, Product *p) {
+    QDialog dlg(this);
+    dlg.setWindowTitle(title);
     QFormLayout *layout = new QFormLayout(&dlg);
 
-    QLineEdit *editCode = new QLineEdit();
-    QLineEdit *editName = new QLineEdit();
+    QLineEdit *editCode = new QLineEdit(p->code);
+    QLineEdit *editName = new QLineEdit(p->name);
     QComboBox *comboCat = new QComboBox();
     comboCat->addItems({"电子产品", "办公用品", "原材料", "食品", "其他"});
     comboCat->setEditable(true);
-    QLineEdit *editUnit = new QLineEdit("个");
+    if (!p->category.isEmpty()) comboCat->setCurrentText(p->category);
+    QLineEdit *editUnit = new QLineEdit(p->unit.isEmpty() ? QString("个") : p->unit);
     QDoubleSpinBox *spinPrice = new QDoubleSpinBox();
     spinPrice->setMaximum(999999.99);
+    spinPrice->setValue(p->price);
     QSpinBox *spinMin = new QSpinBox();
     spinMin->setRange(0, 10000);
+    spinMin->setValue(p->minStock);
 
     layout->addRow("编号 (唯一)*:", editCode);
     layout->addRow("名称*:", editName);
@@ -122,37 +361,263 @@ void MainWindow::onAddProduct() {
     connect(box, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
     connect(box, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
 
-    if (dlg.exec() == QDialog::Accepted) {
-        QString code = editCode->text().trimmed();
-        QString name = editName->text().trimmed();
-        if (code.isEmpty() || name.isEmpty()) {
-            QMessageBox::warning(this, "警告", "编号和名称不能为空！");
-            return;
-        }
+    if (dlg.exec() != QDialog::Accepted) return false;
+
+    p->code = editCode->text().trimmed();
+    p->name = editName->text().trimmed();
+    p->category = comboCat->currentText();
+    p->unit = editUnit->text();
+    p->price = spinPrice->value();
+    p->minStock = spinMin->value();
+    if (p->code.isEmpty() || p->name.isEmpty()) {
+        QMessageBox::warning(this, "警告", "编号和名称不能为空！");
+        return false;
+    }
+    return true;
+}
 
-        if (DbManager::instance().isCodeExists(code)) {
+//新增货品
+void MainWindow::onAddProduct() {
+    Product p;
+    p.id = -1;
+    p.price = 0;
+    p.quantity = 0;
+    p.minStock = 0;
+    if (!productDialog("新增货品", &p)) return;
+
+    if (DbManager::instance().isCodeExists(p.code)) {
+        //软删除的货品仍占用编号：提示恢复原货品（保留其ID和历史记录）
+        const int deletedId = DbManager::instance().deletedProductId(p.code);
+        if (deletedId <= 0) {
             QMessageBox::warning(this, "错误", "该编号已存在，请更换！");
             return;
         }
-
-        Product p;
-        p.code = code;
-        p.name = name;
-        p.category = comboCat->currentText();
-        p.unit = editUnit->text();
-        p.price = spinPrice->value();
-        p.quantity = 0;
-        p.minStock = spinMin->value();
-
-        if (DbManager::instance().addProduct(p)) {
+        const Product old = DbManager::instance().getProductById(deletedId);
+        if (QMessageBox::question(this, "编号已被占用",
+                                  QString("编号 %1 属于已删除的货品「%2」。\n是否恢复该货品（保留原有的出入库记录）？")
+                                      .arg(p.code, old.name)) != QMessageBox::Yes)
+            return;
+        if (DbManager::instance().restoreProduct(deletedId)) {
+            //撤销恢复即重新删除，与撤销新增相同
+            m_undoStack->push(new ProductCommand(ProductCommand::Add, Product(), DbManager::instance().getProductById(deletedId)));
             m_productModel->reload();
-            QMessageBox::information(this, "成功", "货品添加成功");
+            QMessageBox::information(this, "成功", "货品已恢复，如需修改资料请使用“修改货品”");
         } else {
             QMessageBox::critical(this, "失败", "数据库写入失败");
         }
+        return;
+    }
+
+    if (DbManager::instance().addProduct(p, &p.id)) {
+        m_undoStack->push(new ProductCommand(ProductCommand::Add, Product(), p));
+        m_productModel->reload();
+        QMessageBox::information(this, "成功", "货品添加成功");
+    } else {
+        QMessageBox::critical(this, "失败", "数据库写入失败");
+    }
+}
+
+//当前选中的货品（库存表），没有选中时 id 为 -1
+Product MainWindow::selectedProduct() {
+    const QModelIndex index = ui->tableStock->currentIndex();
+    if (!index.isValid()) {
+        Product none;
+        none.id = -1;
+        return none;
+    }
+    return m_productModel->getProduct(m_proxyModel->mapToSource(index).row());
+}
+
+//修改货品资料（库存数量只能通过出入库变动）
+void MainWindow::onEditProduct() {
+    const Product before = selectedProduct();
+    if (before.id <= 0) {
+        QMessageBox::warning(this, "提示", "请先在库存表中选择一个货品");
+        return;
+    }
+    //有未保存的表格修改时对话框从修改后的资料开始；保存后去掉这一行的暂存修改，
+    //否则之后的批量保存会用旧的暂存内容覆盖对话框里的修改
+    Product after = m_productModel->editedProduct(m_proxyModel->mapToSource(ui->tableStock->currentIndex()).row());
+    if (!productDialog("修改货品", &after)) return;
+
+    if (after.code != before.code && DbManager::instance().isCodeExists(after.code)) {
+        QMessageBox::warning(this, "错误", DbManager::instance().deletedProductId(after.code) > 0
+                                               ? "该编号属于一个已删除的货品，请更换！"
+                                               : "该编号已存在，请更换！");
+        return;
+    }
+
+    if (DbManager::instance().updateProduct(after)) {
+        m_undoStack->push(new ProductCommand(ProductCommand::Update, before, after));
+        m_productModel->discardPending(before.id);
+        m_productModel->reload();
+    } else {
+        QMessageBox::critical(this, "失败", "数据库写入失败");
     }
 }
 
+//删除货品：软删除，历史记录保留，可撤销
+void MainWindow::onDeleteProduct() {
+    const Product p = selectedProduct();
+    if (p.id <= 0) {
+        QMessageBox::warning(this, "提示", "请先在库存表中选择一个货品");
+        return;
+    }
+    if (QMessageBox::question(this, "确认", QString("确定删除货品 %1 %2 吗？\n出入库记录会保留，删除后可以撤销。")
+                                                .arg(p.code, p.name)) != QMessageBox::Yes)
+        return;
+
+    if (DbManager::instance().deleteProduct(p.id)) {
+        m_undoStack->push(new ProductCommand(ProductCommand::Delete, p, Product()));
+        m_productModel->reload();
+    } else {
+        QMessageBox::critical(this, "失败", "数据库写入失败");
+    }
+}
+
+//批量调价：有选中的行时只改选中的行（包括只选一行），没有选中时改当前筛选出的全部货品，
+//对话框标题写明范围；改动先暂存，保存时一次提交
+void MainWindow::onBulkPrice() {
+    QList<int> rows;
+    const QModelIndexList selected = ui->tableStock->selectionModel()->selectedRows();
+    if (!selected.isEmpty()) {
+        for (const QModelIndex &index : selected) rows << m_proxyModel->mapToSource(index).row();
+    } else {
+        rows.reserve(m_proxyModel->rowCount());
+        for (int i = 0; i < m_proxyModel->rowCount(); ++i)
+            rows << m_proxyModel->mapToSource(m_proxyModel->index(i, 0)).row();
+    }
+    if (rows.isEmpty()) {
+        QMessageBox::warning(this, "提示", "当前没有可调价的货品");
+        return;
+    }
+
+    QDialog dlg(this);
+    dlg.setWindowTitle(selected.isEmpty() ? QString("批量调价（当前筛选出的全部 %1 个货品）").arg(rows.size())
+                                          : QString("批量调价（选中的 %1 个货品）").arg(rows.size()));
+    QFormLayout *layout = new QFormLayout(&dlg);
+    QComboBox *comboMode = new QComboBox();
+    comboMode->addItems({"按百分比调整", "设为统一单价"});
+    QDoubleSpinBox *spinValue = new QDoubleSpinBox();
+    spinValue->setRange(-100, 1000);
+    spinValue->setSuffix(" %");
+    connect(comboMode, QOverload<int>::of(&QComboBox::currentIndexChanged), spinValue, [spinValue](int mode) {
+        if (mode == 0) {
+            spinValue->setRange(-100, 1000);
+            spinValue->setSuffix(" %");
+        } else {
+            spinValue->setRange(0, 999999.99);
+            spinValue->setSuffix(QString());
+        }
+    });
+    layout->addRow("方式:", comboMode);
+    layout->addRow("数值:", spinValue);
+
+    QDialogButtonBox *box = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout->addWidget(box);
+    connect(box, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    connect(box, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+    if (dlg.exec() != QDialog::Accepted) return;
+
+    const int changed = comboMode->currentIndex() == 0
+        ? m_productModel->scalePrices(rows, spinValue->value())
+        : m_productModel->setRowsData(rows, ProductModel::ColPrice, spinValue->value());
+    ui->statusbar->showMessage(QString("已调整 %1 个货品的单价，保存后生效（Ctrl+S）").arg(changed));
+}
+
+//正在编辑的单元格先写回模型并关闭编辑框：通过委托的 commitData / closeEditor 信号，
+//与按回车提交的流程相同，不依赖编辑框失去焦点时的行为
+void MainWindow::commitOpenEditor() {
+    if (ui->tableStock->state() != QAbstractItemView::EditingState) return;
+    QWidget *editor = QApplication::focusWidget();
+    while (editor && editor->parentWidget() != ui->tableStock->viewport()) editor = editor->parentWidget();
+    if (!editor) return;
+    QAbstractItemDelegate *delegate = ui->tableStock->itemDelegate(ui->tableStock->currentIndex());
+    emit delegate->commitData(editor);
+    emit delegate->closeEditor(editor, QAbstractItemDelegate::NoHint);
+}
+
+//保存库存表中的修改：一个事务写入全部改动，作为一步压入撤销栈
+void MainWindow::onSaveEdits() {
+    commitOpenEditor();
+
+    QList<Product> before;
+    int missing = 0;
+    const QList<Product> after = m_productModel->pendingChanges(&before, &missing);
+    //后台加载期间表中还缺后面的分页，修改的货品可能只是尚未到达，保留修改稍后再存
+    if (missing > 0 && m_productModel->isLoading()) {
+        QMessageBox::information(this, "提示", "货品列表仍在加载，请加载完成后再保存");
+        return;
+    }
+    //其余不在表中的货品已被删除（或被导入、恢复覆盖），这部分修改无法保存，明确告知后放弃
+    if (missing > 0) {
+        QMessageBox::warning(this, "提示", QString("%1 个货品已不存在，它们的修改将被放弃").arg(missing));
+    }
+    if (after.isEmpty()) {
+        m_productModel->clearPending();
+        return;
+    }
+
+    if (DbManager::instance().updateProductsBatch(after)) {
+        m_undoStack->push(new ProductBatchCommand(before, after));
+        m_productModel->clearPending();
+        m_productModel->reload();
+        QString message = QString("已保存 %1 个货品的修改").arg(after.size());
+        if (missing > 0) message += QString("，放弃 %1 个已不存在货品的修改").arg(missing);
+        ui->statusbar->showMessage(message);
+    } else {
+        QMessageBox::critical(this, "失败", "数据库写入失败，修改未保存");
+    }
+}
+
+void MainWindow::onRevertEdits() {
+    m_productModel->clearPending();
+    ui->statusbar->showMessage("已放弃未保存的修改");
+}
+
+void MainWindow::onPendingEditsChanged(int count) {
+    if (count > 0) ui->statusbar->showMessage(QString("%1 个货品有未保存的修改（Ctrl+S 保存）").arg(count));
+}
+
+bool MainWindow::resolvePendingEdits() {
+    if (!m_productModel || !m_productModel->hasPendingChanges()) return true;
+    const QMessageBox::StandardButton answer = QMessageBox::question(
+        this, "未保存的修改", QString("库存表中有 %1 个货品的修改尚未保存，是否保存？").arg(m_productModel->pendingCount()),
+        QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
+    if (answer == QMessageBox::Cancel) return false;
+    if (answer == QMessageBox::Save) {
+        onSaveEdits();
+        return !m_productModel->hasPendingChanges();
+    }
+    m_productModel->clearPending();
+    return true;
+}
+
+void MainWindow::closeEvent(QCloseEvent *event) {
+    if (resolvePendingEdits()) event->accept();
+    else event->ignore();
+}
+
+//撤销 / 重做：失败的命令会被移出栈，提示原因
+void MainWindow::onUndo() {
+    UndoCommands::clearError();
+    m_undoStack->undo();
+    afterUndoRedo();
+}
+
+void MainWindow::onRedo() {
+    UndoCommands::clearError();
+    m_undoStack->redo();
+    afterUndoRedo();
+}
+
+void MainWindow::afterUndoRedo() {
+    if (!UndoCommands::lastError().isEmpty())
+        QMessageBox::critical(this, "操作失败", UndoCommands::lastError());
+    m_productModel->reload();
+    if (ui->tabWidget->currentIndex() == 2) m_recordModel->reload();
+}
+
 //出入库提交 ---
 void MainWindow::onSubmitOperation() {
     //获取选中的货品ID
@@ -162,6 +627,8 @@ void MainWindow::onSubmitOperation() {
         return;
     }
     int pId = ui->comboProduct->currentData().toInt();
+    int locationId = ui->comboLocation->currentIndex() >= 0 ? ui->comboLocation->currentData().toInt()
+                                                            : DefaultLocationId;
 
     //获取参数
     int count = ui->spinCount->value();
@@ -169,14 +636,15 @@ void MainWindow::onSubmitOperation() {
     bool isInbound = ui->radioIn->isChecked();
 
     //调用核心逻辑
-    QString error = DbManager::instance().adjustStock(pId, count, isInbound, remark);
+    QString error = DbManager::instance().adjustStock(pId, count, isInbound, remark, locationId);
 
     if (error.isEmpty()) {
+        m_undoStack->push(new MovementCommand({pId, count, isInbound, remark, locationId},
+                                              ui->comboProduct->currentText()));
         QMessageBox::information(this, "成功", isInbound ? "入库成功！" : "出库成功！");
         ui->editRemark->clear();
         ui->spinCount->setValue(1);
-        m_productModel->reload();
-        refreshComboList();
+        m_productModel->reload(); // 重置后下拉框随之重建
 
     } else {
         QMessageBox::critical(this, "操作失败", error);
@@ -204,23 +672,74 @@ void MainWindow::onWorkerProgress(int current, int total) {
     }
 }
 
-void MainWindow::onWorkerFinished(bool success, QString msg) {
+void MainWindow::closeProgress() {
     if (m_progressDlg) {
         m_progressDlg->close();
-        delete m_progressDlg;
+        m_progressDlg->deleteLater(); // 可能正处于对话框自己的 canceled 信号中
         m_progressDlg = nullptr;
     }
+}
+
+void MainWindow::onWorkerFinished(bool success, QString msg) {
+    closeProgress();
+
+    //恢复：后台线程只解压和检查了副本，覆盖主库要用主连接，在这里进行，期间界面阻塞
+    DataWorker *worker = qobject_cast<DataWorker *>(sender());
+    if (success && worker && worker->taskType() == TaskType::Restore) {
+        QApplication::setOverrideCursor(Qt::WaitCursor);
+        QString error;
+        success = DbManager::instance().restoreFrom(DataWorker::restoreStagingPath(), &error);
+        QApplication::restoreOverrideCursor();
+        QFile::remove(DataWorker::restoreStagingPath());
+        if (!success) msg = "恢复失败: " + error;
+    }
+
+    //导入会直接写入库存数量（没有对应的出入库记录），导入后立即补一个检查点
+    //新导入的货品还没有分仓库存，先归入默认仓库
+    if (success && worker && (worker->taskType() == TaskType::ImportStock
+                              || worker->taskType() == TaskType::ImportSnapshot
+                              || worker->taskType() == TaskType::Restore)) {
+        SnapshotStore::instance().invalidate();
+        //栈中命令记的货品ID属于被替换掉的数据，撤销会作用到现在同ID的货品上
+        m_undoStack->clear();
+        DbManager::instance().reconcileStockLevels();
+        //旧快照里的记录没有货品编号和名称（恢复的旧备份已由 initSchema 按版本补过）
+        if (worker->taskType() == TaskType::ImportSnapshot) DbManager::instance().backfillRecordProducts();
+        DbManager::instance().createCheckpoint();
+        RequestKeyFilter::instance().invalidate();
+    }
 
     if (success) {
         QMessageBox::information(this, "完成", msg);
+        LowStockMonitor::instance().reload();
+        Forecaster::instance().reload();
+        ReportEngine::instance().invalidateAll();
         m_productModel->reload();
         m_recordModel->reload();
-        refreshComboList();
     } else {
         QMessageBox::critical(this, "错误", msg);
     }
 }
 
+DataWorker *MainWindow::createWorker(TaskType type, const QString &path) {
+    DataWorker *worker = new DataWorker(this);
+    worker->setTask(type, path);
+    //导出使用当前的共享快照：货品部分随库存表加载，记录部分只有打开过历史记录页才在内存中，
+    //没有时导出线程仍然查库
+    if (type == TaskType::ExportStock)
+        worker->setSnapshot(SnapshotStore::instance().acquire(false));
+    else if (type == TaskType::ExportRecord)
+        worker->setSnapshot(SnapshotStore::instance().current());
+
+    connect(worker, &DataWorker::progressUpdated, this, &MainWindow::onWorkerProgress);
+    connect(worker, &DataWorker::progressMessage, this, [this](const QString &message) {
+        if (m_progressDlg) m_progressDlg->setLabelText(message);
+    });
+    connect(worker, &DataWorker::taskFinished, this, &MainWindow::onWorkerFinished);
+    connect(worker, &DataWorker::finished, worker, &QObject::deleteLater);
+    return worker;
+}
+
 //导出库存
 void MainWindow::onStockExport() {
     QString path = QFileDialog::getSaveFileName(this, "导出库存", "stocks.csv", "CSV Files (*.csv)");
@@ -228,34 +747,21 @@ void MainWindow::onStockExport() {
 
     showProgress("正在导出库存数据...");
 
-    DataWorker *worker = new DataWorker(this);
-    worker->setTask(TaskType::ExportStock, path);
-
-    connect(worker, &DataWorker::progressUpdated, this, &MainWindow::onWorkerProgress);
-    connect(worker, &DataWorker::taskFinished, this, &MainWindow::onWorkerFinished);
-    connect(worker, &DataWorker::finished, worker, &QObject::deleteLater);
-
-    worker->start();
+    createWorker(TaskType::ExportStock, path)->start();
 }
 
 //导入库存
 void MainWindow::onStockImport() {
+    if (!resolvePendingEdits()) return;
     QString path = QFileDialog::getOpenFileName(this, "选择导入文件", "", "CSV Files (*.csv)");
     if (path.isEmpty()) return;
 
-    if (QMessageBox::question(this, "确认", "批量导入可能需要一些时间，建议先备份数据库。\n确定继续吗？") != QMessageBox::Yes)
+    if (QMessageBox::question(this, "确认", "批量导入可能需要一些时间，建议先备份数据库（数据 → 备份数据库）。\n确定继续吗？") != QMessageBox::Yes)
         return;
 
     showProgress("正在批量导入，请稍候...");
 
-    DataWorker *worker = new DataWorker(this);
-    worker->setTask(TaskType::ImportStock, path);
-
-    connect(worker, &DataWorker::progressUpdated, this, &MainWindow::onWorkerProgress);
-    connect(worker, &DataWorker::taskFinished, this, &MainWindow::onWorkerFinished);
-    connect(worker, &DataWorker::finished, worker, &QObject::deleteLater);
-
-    worker->start();
+    createWorker(TaskType::ImportStock, path)->start();
 }
 
 //导出记录
@@ -265,16 +771,369 @@ void MainWindow::onRecordExport() {
 
     showProgress("正在导出历史记录...");
 
-    DataWorker *worker = new DataWorker(this);
-    worker->setTask(TaskType::ExportRecord, path);
+    createWorker(TaskType::ExportRecord, path)->start();
+}
 
-    connect(worker, &DataWorker::progressUpdated, this, &MainWindow::onWorkerProgress);
-    connect(worker, &DataWorker::taskFinished, this, &MainWindow::onWorkerFinished);
-    connect(worker, &DataWorker::finished, worker, &QObject::deleteLater);
+//导出二进制快照，选择 .whsz 时启用压缩
+void MainWindow::onSnapshotExport() {
+    QString path = QFileDialog::getSaveFileName(this, "导出快照", "warehouse.whsz",
+                                                "压缩快照 (*.whsz);;快照 (*.whs)");
+    if (path.isEmpty()) return;
+
+    showProgress("正在导出快照...");
 
+    DataWorker *worker = createWorker(TaskType::ExportSnapshot, path);
+    worker->setCompression(path.endsWith(".whsz", Qt::CaseInsensitive));
     worker->start();
 }
 
+//从快照恢复（覆盖当前全部货品和记录）
+void MainWindow::onSnapshotImport() {
+    if (!resolvePendingEdits()) return;
+    QString path = QFileDialog::getOpenFileName(this, "选择快照文件", "", "快照 (*.whs *.whsz)");
+    if (path.isEmpty()) return;
+
+    if (QMessageBox::question(this, "确认", "恢复快照将覆盖当前所有货品和出入库记录。\n确定继续吗？") != QMessageBox::Yes)
+        return;
+
+    showProgress("正在从快照恢复...");
+    createWorker(TaskType::ImportSnapshot, path)->start();
+}
+
+//在线备份：备份期间可以继续出入库，选择 .whbk 时压缩
+void MainWindow::onBackup() {
+    const QString name = QString("warehouse-%1.whbk").arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmm"));
+    QString path = QFileDialog::getSaveFileName(this, "备份数据库", name,
+                                                "压缩备份 (*.whbk);;SQLite 数据库 (*.db)");
+    if (path.isEmpty()) return;
+
+    showProgress("正在备份数据库...");
+    DataWorker *worker = createWorker(TaskType::Backup, path);
+    connect(m_progressDlg, &QProgressDialog::canceled, worker, [worker] { worker->requestInterruption(); });
+    worker->start();
+}
+
+//从备份恢复（覆盖当前整个数据库）
+void MainWindow::onRestore() {
+    if (!resolvePendingEdits()) return;
+    QString path = QFileDialog::getOpenFileName(this, "选择备份文件", "", "备份 (*.whbk *.db)");
+    if (path.isEmpty()) return;
+
+    if (QMessageBox::question(this, "确认", "从备份恢复将覆盖当前全部数据（货品、记录、仓库和检查点）。\n确定继续吗？") != QMessageBox::Yes)
+        return;
+
+    showProgress("正在从备份恢复...");
+    createWorker(TaskType::Restore, path)->start();
+}
+
+//历史库存查询：选择时刻，计算当时的库存数量和按当前单价估算的货值
+void MainWindow::onStockAtTime() {
+    QDialog dlg(this);
+    dlg.setWindowTitle("历史库存查询");
+    QFormLayout *layout = new QFormLayout(&dlg);
+
+    QDateTimeEdit *editTime = new QDateTimeEdit(QDateTime::currentDateTime());
+    editTime->setCalendarPopup(true);
+    editTime->setDisplayFormat("yyyy-MM-dd HH:mm:ss");
+    layout->addRow("查询时刻:", editTime);
+
+    QDialogButtonBox *box = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout->addWidget(box);
+    connect(box, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    connect(box, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+
+    if (dlg.exec() != QDialog::Accepted) return;
+
+    QElapsedTimer timer;
+    timer.start();
+    QHash<int, int> stock = DbManager::instance().getStockAt(editTime->dateTime());
+
+    qint64 totalQty = 0;
+    double totalValue = 0;
+    int skuCount = 0;
+    for (const Product &p : DbManager::instance().getAllProducts()) {
+        int qty = stock.value(p.id, 0);
+        if (qty == 0) continue;
+        skuCount++;
+        totalQty += qty;
+        totalValue += qty * p.price;
+    }
+
+    QMessageBox::information(this, "历史库存",
+        QString("时刻: %1\n有库存的货品: %2 种\n库存总量: %3\n货值(按当前单价): %4\n\n耗时 %5 ms")
+            .arg(editTime->dateTime().toString("yyyy-MM-dd HH:mm:ss"))
+            .arg(skuCount).arg(totalQty).arg(totalValue, 0, 'f', 2).arg(timer.elapsed()));
+}
+
+//新增仓库
+void MainWindow::onAddLocation() {
+    QDialog dlg(this);
+    dlg.setWindowTitle("新增仓库");
+    QFormLayout *layout = new QFormLayout(&dlg);
+
+    QLineEdit *editCode = new QLineEdit();
+    QLineEdit *editName = new QLineEdit();
+    layout->addRow("编号 (唯一)*:", editCode);
+    layout->addRow("名称*:", editName);
+
+    QDialogButtonBox *box = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout->addWidget(box);
+    connect(box, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    connect(box, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+
+    if (dlg.exec() != QDialog::Accepted) return;
+
+    Location l;
+    l.code = editCode->text().trimmed();
+    l.name = editName->text().trimmed();
+    if (l.code.isEmpty() || l.name.isEmpty()) {
+        QMessageBox::warning(this, "警告", "编号和名称不能为空！");
+        return;
+    }
+    if (DbManager::instance().addLocation(l)) {
+        fillLocationCombo(ui->comboLocation);
+        QMessageBox::information(this, "成功", "仓库添加成功");
+    } else {
+        QMessageBox::critical(this, "失败", "仓库写入失败，请检查编号是否重复");
+    }
+}
+
+//仓库间调拨
+void MainWindow::onTransferStock() {
+    QDialog dlg(this);
+    dlg.setWindowTitle("库存调拨");
+    QFormLayout *layout = new QFormLayout(&dlg);
+
+    QComboBox *comboProduct = new QComboBox();
+    for (const Product &p : DbManager::instance().getAllProducts())
+        comboProduct->addItem(p.code + " - " + p.name, QVariant(p.id));
+    QComboBox *comboFrom = new QComboBox();
+    QComboBox *comboTo = new QComboBox();
+    fillLocationCombo(comboFrom);
+    fillLocationCombo(comboTo);
+    QLabel *labelAvailable = new QLabel();
+    QSpinBox *spinCount = new QSpinBox();
+    spinCount->setRange(1, 999999);
+    QLineEdit *editRemark = new QLineEdit();
+
+    //显示调出仓库的当前库存
+    auto updateAvailable = [=] {
+        labelAvailable->setText(QString::number(LocationStock::instance().quantity(
+            comboProduct->currentData().toInt(), comboFrom->currentData().toInt())));
+    };
+    connect(comboProduct, QOverload<int>::of(&QComboBox::currentIndexChanged), &dlg, updateAvailable);
+    connect(comboFrom, QOverload<int>::of(&QComboBox::currentIndexChanged), &dlg, updateAvailable);
+    updateAvailable();
+
+    layout->addRow("货品:", comboProduct);
+    layout->addRow("调出仓库:", comboFrom);
+    layout->addRow("可调数量:", labelAvailable);
+    layout->addRow("调入仓库:", comboTo);
+    layout->addRow("数量:", spinCount);
+    layout->addRow("备注:", editRemark);
+
+    QDialogButtonBox *box = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout->addWidget(box);
+    connect(box, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    connect(box, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+
+    if (dlg.exec() != QDialog::Accepted || comboProduct->currentIndex() < 0) return;
+
+    QString error = DbManager::instance().transferStock(comboProduct->currentData().toInt(),
+                                                        comboFrom->currentData().toInt(),
+                                                        comboTo->currentData().toInt(),
+                                                        spinCount->value(), editRemark->text());
+    if (error.isEmpty()) {
+        QMessageBox::information(this, "成功", "调拨成功！");
+        m_recordModel->reload();
+    } else {
+        QMessageBox::critical(this, "调拨失败", error);
+    }
+}
+
+//终端采集服务：端口默认 7070，可用环境变量 WAREHOUSE_INGEST_PORT 指定；
+//默认只监听本机，WAREHOUSE_INGEST_BIND 指定监听地址（如 0.0.0.0 供局域网终端连接）；
+//连接令牌取 WAREHOUSE_INGEST_TOKEN，未设置时每次运行随机生成并显示给操作员
+void MainWindow::onToggleIngestServer(bool on) {
+    if (!m_ingestServer) {
+        m_ingestServer = new IngestServer(this);
+        connect(m_ingestServer, &IngestServer::movementsApplied, this, &MainWindow::onIngestApplied);
+        m_ingestRefreshTimer = new QTimer(this);
+        m_ingestRefreshTimer->setSingleShot(true);
+        m_ingestRefreshTimer->setInterval(1000);
+        connect(m_ingestRefreshTimer, &QTimer::timeout, this, [this] {
+            m_productModel->reload();
+            if (ui->tabWidget->currentIndex() == 2) m_recordModel->reload();
+        });
+    }
+
+    if (!on) {
+        m_ingestServer->stop();
+        ui->statusbar->showMessage("终端采集服务已停止");
+        return;
+    }
+
+    int port = qEnvironmentVariableIntValue("WAREHOUSE_INGEST_PORT");
+    if (port <= 0 || port > 65535) port = IngestServer::DefaultPort;
+    QHostAddress address(QHostAddress::LocalHost);
+    const QString bind = qEnvironmentVariable("WAREHOUSE_INGEST_BIND");
+    if (!bind.isEmpty() && !address.setAddress(bind)) {
+        QMessageBox::critical(this, "错误", "WAREHOUSE_INGEST_BIND 不是有效的地址: " + bind);
+        QSignalBlocker blocker(m_ingestAction);
+        m_ingestAction->setChecked(false);
+        return;
+    }
+    QString token = qEnvironmentVariable("WAREHOUSE_INGEST_TOKEN");
+    const bool generated = token.isEmpty();
+    if (generated) {
+        if (m_ingestToken.isEmpty()) {
+            for (int i = 0; i < 4; ++i)
+                m_ingestToken += QString::number(QRandomGenerator::system()->generate(), 16).rightJustified(8, '0');
+        }
+        token = m_ingestToken;
+    }
+
+    if (m_ingestServer->start(token, quint16(port), address)) {
+        ui->statusbar->showMessage(QString("终端采集服务已启动，%1:%2").arg(address.toString()).arg(port));
+        if (generated)
+            QMessageBox::information(this, "终端采集服务",
+                                     QString("终端连接令牌（本次运行有效）:\n%1\n\n"
+                                             "可通过环境变量 WAREHOUSE_INGEST_TOKEN 指定固定令牌。").arg(token));
+    } else {
+        QMessageBox::critical(this, "错误", "终端采集服务启动失败: " + m_ingestServer->errorString());
+        QSignalBlocker blocker(m_ingestAction);
+        m_ingestAction->setChecked(false);
+    }
+}
+
+//终端提交频繁时，每秒最多刷新一次界面
+void MainWindow::onIngestApplied() {
+    if (!m_ingestRefreshTimer->isActive()) m_ingestRefreshTimer->start();
+}
+
+void MainWindow::showReport(const QString &title, const ReportTable &table) {
+    QDialog dlg(this);
+    dlg.setWindowTitle(title);
+    dlg.resize(700, 500);
+    QVBoxLayout *layout = new QVBoxLayout(&dlg);
+
+    QTableWidget *view = new QTableWidget(table.rows.size(), table.headers.size());
+    view->setHorizontalHeaderLabels(table.headers);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->horizontalHeader()->setStretchLastSection(true);
+    for (int r = 0; r < table.rows.size(); ++r) {
+        const QVariantList &row = table.rows.at(r);
+        for (int c = 0; c < row.size(); ++c) {
+            QTableWidgetItem *item = new QTableWidgetItem();
+            item->setData(Qt::DisplayRole, row.at(c));
+            view->setItem(r, c, item);
+        }
+    }
+    view->setSortingEnabled(true);
+    layout->addWidget(view);
+
+    layout->addWidget(new QLabel(QString("共 %1 行，计算耗时 %2 ms%3")
+                                     .arg(table.rows.size())
+                                     .arg(table.elapsedUs / 1000.0, 0, 'f', 1)
+                                     .arg(table.fromCache ? "（缓存）" : "")));
+
+    QDialogButtonBox *box = new QDialogButtonBox(QDialogButtonBox::Close);
+    layout->addWidget(box);
+    connect(box, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+    dlg.exec();
+}
+
+void MainWindow::onReportStockValue() {
+    showReport("库存货值（按分类）", ReportEngine::instance().stockValueByCategory());
+}
+
+//出入库汇总：选择时间范围和汇总方式
+void MainWindow::onReportMovements() {
+    QDialog dlg(this);
+    dlg.setWindowTitle("出入库汇总");
+    QFormLayout *layout = new QFormLayout(&dlg);
+
+    QDateEdit *editFrom = new QDateEdit(QDate::currentDate().addMonths(-1));
+    QDateEdit *editTo = new QDateEdit(QDate::currentDate());
+    editFrom->setCalendarPopup(true);
+    editTo->setCalendarPopup(true);
+    QComboBox *comboGroup = new QComboBox();
+    comboGroup->addItems({"按日", "按周", "按月", "按货品"});
+
+    layout->addRow("开始日期:", editFrom);
+    layout->addRow("结束日期:", editTo);
+    layout->addRow("汇总方式:", comboGroup);
+
+    QDialogButtonBox *box = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout->addWidget(box);
+    connect(box, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    connect(box, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+
+    if (dlg.exec() != QDialog::Accepted) return;
+
+    QDateTime from(editFrom->date(), QTime(0, 0));
+    QDateTime to(editTo->date(), QTime(23, 59, 59));
+    ReportEngine &engine = ReportEngine::instance();
+    switch (comboGroup->currentIndex()) {
+    case 0: showReport("出入库汇总（按日）", engine.movementsByPeriod(ReportPeriod::Day, from, to)); break;
+    case 1: showReport("出入库汇总（按周）", engine.movementsByPeriod(ReportPeriod::Week, from, to)); break;
+    case 2: showReport("出入库汇总（按月）", engine.movementsByPeriod(ReportPeriod::Month, from, to)); break;
+    default: showReport("出入库汇总（按货品）", engine.movementsByProduct(from, to)); break;
+    }
+}
+
+void MainWindow::onReportTopMovers() {
+    QDialog dlg(this);
+    dlg.setWindowTitle("出入库排行");
+    QFormLayout *layout = new QFormLayout(&dlg);
+
+    QDateEdit *editFrom = new QDateEdit(QDate::currentDate().addMonths(-1));
+    QDateEdit *editTo = new QDateEdit(QDate::currentDate());
+    editFrom->setCalendarPopup(true);
+    editTo->setCalendarPopup(true);
+    QSpinBox *spinTop = new QSpinBox();
+    spinTop->setRange(1, 1000);
+    spinTop->setValue(20);
+
+    layout->addRow("开始日期:", editFrom);
+    layout->addRow("结束日期:", editTo);
+    layout->addRow("显示前:", spinTop);
+
+    QDialogButtonBox *box = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    layout->addWidget(box);
+    connect(box, &QDialogButtonBox::accepted, &dlg, &QDialog::accept);
+    connect(box, &QDialogButtonBox::rejected, &dlg, &QDialog::reject);
+
+    if (dlg.exec() != QDialog::Accepted) return;
+
+    QDateTime from(editFrom->date(), QTime(0, 0));
+    QDateTime to(editTo->date(), QTime(23, 59, 59));
+    showReport("出入库排行", ReportEngine::instance().topMovers(from, to, spinTop->value()));
+}
+
+//各仓库汇总由 LocationStock 增量维护，直接读取
+void MainWindow::onReportLocations() {
+    QElapsedTimer timer;
+    timer.start();
+    ReportTable table;
+    table.headers << "仓库编号" << "仓库名称" << "货品种数" << "库存总量" << "货值";
+    for (const LocationSummary &s : LocationStock::instance().summaries())
+        table.rows.append({s.code, s.name, s.skuCount, s.units, QString::number(s.value, 'f', 2)});
+    table.elapsedUs = timer.nsecsElapsed() / 1000;
+    showReport("各仓库库存汇总", table);
+}
+
+void MainWindow::onSearchRecords() {
+    QElapsedTimer timer;
+    timer.start();
+    m_recordModel->setSearch(ui->editRecordSearch->text());
+    if (!m_recordModel->search().isEmpty())
+        ui->statusbar->showMessage(QString("搜索 \"%1\" 用时 %2 ms%3")
+                                       .arg(m_recordModel->search()).arg(timer.elapsed())
+                                       .arg(m_recordModel->canFetchMore(QModelIndex()) ? "，滚动到底部加载更多" : ""));
+}
+
 void MainWindow::onRefreshRecords() {
     m_recordModel->reload();
     ui->statusbar->showMessage("记录表已刷新");
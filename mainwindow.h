@@ -2,11 +2,20 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QSortFilterProxyModel>
+#include <QLabel>
+#include <QComboBox>
+#include <QTimer>
+#include <QAction>
+#include <QElapsedTimer>
+#include <QUndoStack>
 #include <QProgressDialog>
 #include "productmodel.h"
 #include "recordmodel.h"
+#include "productfilterproxy.h"
+#include "reportengine.h"
 #include "dataworker.h"
+#include "metricsdock.h"
+#include "ingestserver.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -20,18 +29,48 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+protected:
+    void closeEvent(QCloseEvent *event) override; // 有未保存的表格修改时询问
+
 private slots:
     // --- 界面交互槽函数 ---
     void onTabChanged(int index);   // 切换标签页
     void onSearchStock(const QString &text); // 搜索库存
+    void onLowStockOnly(bool on);   // 仅显示低库存
+    void onStockDoubleClicked(const QModelIndex &index); // 双击货品查看出入库流水
+    void onThresholdCrossed(int productId, bool below); // 货品越过安全库存线
 
     // --- 按钮点击槽函数 ---
     void onAddProduct();            // 新增货品
+    void onEditProduct();           // 修改选中的货品
+    void onDeleteProduct();         // 删除选中的货品（软删除）
+    void onBulkPrice();             // 批量调价（选中的行或当前筛选结果）
+    void onSaveEdits();             // 库存表中的修改一次批量写库
+    void onRevertEdits();           // 放弃库存表中未保存的修改
+    void onPendingEditsChanged(int count);
+    void onUndo();
+    void onRedo();
     void onStockExport();           // 导出库存
     void onStockImport();           // 导入库存
     void onRecordExport();          // 导出记录
+    void onSnapshotExport();        // 导出二进制快照
+    void onSnapshotImport();        // 从快照恢复
+    void onBackup();                // 在线备份数据库
+    void onRestore();               // 从备份恢复数据库
+    void onStockAtTime();           // 历史库存查询（某一时刻的库存与货值）
+    void onAddLocation();           // 新增仓库
+    void onTransferStock();         // 仓库间调拨
+    void onToggleIngestServer(bool on); // 启停终端采集服务
+    void onIngestApplied();         // 终端提交的出入库已入库
+    void deferredStartup();         // 窗口显示之后再做的初始化
+    void markComboDirty();          // 货品数据变化，出入库下拉框需要重建
+    void onReportStockValue();      // 报表：库存货值（按分类）
+    void onReportMovements();       // 报表：出入库汇总（按期间 / 货品）
+    void onReportTopMovers();       // 报表：出入库排行
+    void onReportLocations();       // 报表：各仓库库存汇总
     void onSubmitOperation();       // 提交出入库
     void onRefreshRecords();        // 刷新记录表
+    void onSearchRecords();         // 全文搜索记录
 
     // --- 后台线程回调 ---
     void onWorkerProgress(int current, int total);
@@ -42,15 +81,37 @@ private:
 
     // 模型对象
     ProductModel *m_productModel;
-    QSortFilterProxyModel *m_proxyModel; // 用于库存表的搜索过滤
+    ProductFilterProxy *m_proxyModel; // 用于库存表的搜索过滤
     RecordModel *m_recordModel;
 
     // 辅助功能
     void setupUiLogic();
+    void setupMenus();       // 菜单栏（视图等）
     void refreshComboList(); // 刷新出入库页面的下拉框
+    void fillLocationCombo(QComboBox *combo); // 填充仓库下拉框
     void showProgress(const QString &title); // 显示进度条
+    void closeProgress();
+    DataWorker *createWorker(TaskType type, const QString &path); // 创建后台任务并连接进度信号
+    void showReport(const QString &title, const ReportTable &table); // 以表格对话框展示报表
+    bool productDialog(const QString &title, Product *p); // 货品资料对话框
+    Product selectedProduct();  // 库存表中当前选中的货品
+    void afterUndoRedo();
+    bool resolvePendingEdits(); // 有未保存的修改时询问保存 / 放弃，返回 false 表示取消
+    void commitOpenEditor();    // 库存表中正在编辑的单元格写回模型
 
     QProgressDialog *m_progressDlg; // 进度条对话框
+    MetricsDock *m_metricsDock;     // 性能指标面板
+    QLabel *m_lowStockLabel;        // 状态栏：低库存货品数
+    IngestServer *m_ingestServer;   // 终端采集服务
+    QAction *m_ingestAction;
+    QTimer *m_ingestRefreshTimer;   // 合并采集期间的界面刷新
+    QString m_ingestToken;          // 未指定令牌时本次运行随机生成的终端连接令牌
+    QUndoStack *m_undoStack;        // 本次运行的撤销栈
+    QTimer *m_recordSearchTimer;    // 记录搜索框的输入防抖
+    bool m_comboDirty;              // 出入库下拉框是否需要在下次显示时重建
+    QElapsedTimer m_startupTimer;   // 启动耗时统计
+    static QString firstScreenCachePath();
+    void updateLowStockLabel();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,170 @@
+#include "metrics.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDateTime>
+#include <algorithm>
+
+std::atomic<bool> Metrics::s_enabled(false);
+
+//直方图桶上界（微秒）
+const qint64 Metrics::s_bucketBoundsUs[Metrics::BucketCount - 1] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000,
+    50000, 100000, 250000, 500000, 1000000, 5000000
+};
+
+Metrics& Metrics::instance() {
+    static Metrics instance;
+    return instance;
+}
+
+void Metrics::setEnabled(bool on) {
+    s_enabled.store(on, std::memory_order_relaxed);
+}
+
+void Metrics::addCounter(const char *name, qint64 delta) {
+    QMutexLocker locker(&m_mutex);
+    m_counters[QByteArray(name)] += delta;
+}
+
+void Metrics::observe(const char *name, qint64 nanos, qint64 rows) {
+    const qint64 us = nanos / 1000;
+    int bucket = 0;
+    while (bucket < BucketCount - 1 && us > s_bucketBoundsUs[bucket]) bucket++;
+
+    QMutexLocker locker(&m_mutex);
+    Histogram &h = m_histograms[QByteArray(name)];
+    h.count++;
+    h.rows += rows;
+    h.sumNs += nanos;
+    h.maxNs = qMax(h.maxNs, nanos);
+    h.buckets[bucket]++;
+}
+
+void Metrics::reset() {
+    QMutexLocker locker(&m_mutex);
+    m_counters.clear();
+    m_histograms.clear();
+}
+
+//按桶内线性插值估算分位数
+double Metrics::quantileMs(const Histogram &h, double q) {
+    if (h.count == 0) return 0.0;
+    const double target = q * h.count;
+    qint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        if (h.buckets[i] == 0) continue;
+        if (seen + h.buckets[i] >= target) {
+            double lower = (i == 0) ? 0.0 : s_bucketBoundsUs[i - 1];
+            double upper = (i < BucketCount - 1) ? s_bucketBoundsUs[i] : h.maxNs / 1000.0;
+            double frac = (target - seen) / h.buckets[i];
+            return qMin(lower + (upper - lower) * frac, h.maxNs / 1000.0) / 1000.0;
+        }
+        seen += h.buckets[i];
+    }
+    return h.maxNs / 1e6;
+}
+
+QList<MetricSample> Metrics::samples() const {
+    QMutexLocker locker(&m_mutex);
+    QList<MetricSample> list;
+
+    for (auto it = m_histograms.constBegin(); it != m_histograms.constEnd(); ++it) {
+        const Histogram &h = it.value();
+        MetricSample s;
+        s.name = QString::fromLatin1(it.key());
+        s.isCounter = false;
+        s.count = h.count;
+        s.rows = h.rows;
+        s.sumMs = h.sumNs / 1e6;
+        s.maxMs = h.maxNs / 1e6;
+        s.p50Ms = quantileMs(h, 0.50);
+        s.p95Ms = quantileMs(h, 0.95);
+        list.append(s);
+    }
+    for (auto it = m_counters.constBegin(); it != m_counters.constEnd(); ++it) {
+        MetricSample s;
+        s.name = QString::fromLatin1(it.key());
+        s.isCounter = true;
+        s.count = it.value();
+        s.rows = 0;
+        s.sumMs = s.maxMs = s.p50Ms = s.p95Ms = 0.0;
+        list.append(s);
+    }
+
+    std::sort(list.begin(), list.end(), [](const MetricSample &a, const MetricSample &b) {
+        return a.name < b.name;
+    });
+    return list;
+}
+
+QByteArray Metrics::toPrometheus() const {
+    QMutexLocker locker(&m_mutex);
+    QByteArray out;
+
+    QList<QByteArray> names = m_histograms.keys();
+    std::sort(names.begin(), names.end());
+    for (const QByteArray &name : names) {
+        const Histogram &h = m_histograms[name];
+        const QByteArray metric = "warehouse_" + name + "_seconds";
+        out += "# TYPE " + metric + " histogram\n";
+        qint64 cumulative = 0;
+        for (int i = 0; i < BucketCount; ++i) {
+            cumulative += h.buckets[i];
+            QByteArray le = (i < BucketCount - 1)
+                                ? QByteArray::number(s_bucketBoundsUs[i] / 1e6, 'g', 6)
+                                : QByteArray("+Inf");
+            out += metric + "_bucket{le=\"" + le + "\"} " + QByteArray::number(cumulative) + "\n";
+        }
+        out += metric + "_sum " + QByteArray::number(h.sumNs / 1e9, 'g', 9) + "\n";
+        out += metric + "_count " + QByteArray::number(h.count) + "\n";
+        if (h.rows > 0) {
+            out += "# TYPE warehouse_" + name + "_rows_total counter\n";
+            out += "warehouse_" + name + "_rows_total " + QByteArray::number(h.rows) + "\n";
+        }
+    }
+
+    names = m_counters.keys();
+    std::sort(names.begin(), names.end());
+    for (const QByteArray &name : names) {
+        out += "# TYPE warehouse_" + name + " counter\n";
+        out += "warehouse_" + name + " " + QByteArray::number(m_counters.value(name)) + "\n";
+    }
+    return out;
+}
+
+QByteArray Metrics::toJson() const {
+    QJsonArray histograms;
+    QJsonObject counters;
+    for (const MetricSample &s : samples()) {
+        if (s.isCounter) {
+            counters[s.name] = s.count;
+            continue;
+        }
+        QJsonObject o;
+        o["name"] = s.name;
+        o["count"] = s.count;
+        o["rows"] = s.rows;
+        o["sum_ms"] = s.sumMs;
+        o["avg_ms"] = s.avgMs();
+        o["p50_ms"] = s.p50Ms;
+        o["p95_ms"] = s.p95Ms;
+        o["max_ms"] = s.maxMs;
+        o["rows_per_sec"] = s.rowsPerSec();
+        histograms.append(o);
+    }
+
+    QJsonObject root;
+    root["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    root["histograms"] = histograms;
+    root["counters"] = counters;
+    return QJsonDocument(root).toJson();
+}
+
+bool Metrics::dumpToFile(const QString &path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    const bool json = path.endsWith(".json", Qt::CaseInsensitive);
+    return file.write(json ? toJson() : toPrometheus()) >= 0;
+}
@@ -0,0 +1,105 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+
+// 运行时性能指标：计数器 + 延迟直方图
+// 默认关闭，关闭时每个埋点只有一次原子读；编译时定义 WAREHOUSE_NO_METRICS 可彻底去掉
+
+// 某个指标的汇总（供指标面板显示）
+struct MetricSample {
+    QString name;
+    bool isCounter;     // true: 计数器，只有 count 有意义
+    qint64 count;       // 次数 / 计数值
+    qint64 rows;        // 累计处理行数
+    double sumMs;       // 累计耗时
+    double maxMs;       // 最大耗时
+    double p50Ms;       // 由直方图估算的中位数
+    double p95Ms;       // 由直方图估算的 95 分位
+
+    double avgMs() const { return count > 0 ? sumMs / count : 0.0; }
+    double rowsPerSec() const { return sumMs > 0 ? rows / (sumMs / 1000.0) : 0.0; }
+};
+
+class Metrics
+{
+public:
+    static Metrics& instance();
+
+#ifdef WAREHOUSE_NO_METRICS
+    static bool enabled() { return false; }
+#else
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+#endif
+    static void setEnabled(bool on);
+
+    // 便捷入口：未启用时直接返回
+    static void count(const char *name, qint64 delta = 1) {
+        if (enabled()) instance().addCounter(name, delta);
+    }
+
+    void addCounter(const char *name, qint64 delta);
+    void observe(const char *name, qint64 nanos, qint64 rows);
+
+    QList<MetricSample> samples() const;
+    void reset();
+
+    QByteArray toPrometheus() const;
+    QByteArray toJson() const;
+    bool dumpToFile(const QString &path) const; // 后缀为 .json 时输出 JSON，否则输出 Prometheus 文本格式
+
+private:
+    Metrics() = default;
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    static const int BucketCount = 16;
+    static const qint64 s_bucketBoundsUs[BucketCount - 1]; // 最后一个桶为 +Inf
+
+    struct Histogram {
+        qint64 count = 0;
+        qint64 rows = 0;
+        qint64 sumNs = 0;
+        qint64 maxNs = 0;
+        qint64 buckets[BucketCount] = {};
+    };
+
+    static double quantileMs(const Histogram &h, double q);
+
+    static std::atomic<bool> s_enabled;
+
+    mutable QMutex m_mutex;
+    QHash<QByteArray, qint64> m_counters;
+    QHash<QByteArray, Histogram> m_histograms;
+};
+
+// 作用域计时器：构造时开始计时，析构时记录到同名直方图
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char *name)
+        : m_name(Metrics::enabled() ? name : nullptr), m_rows(0) {
+        if (m_name) m_timer.start();
+    }
+    ~ScopedTimer() {
+        if (m_name) Metrics::instance().observe(m_name, m_timer.nsecsElapsed(), m_rows);
+    }
+
+    void setRows(qint64 rows) { m_rows = rows; }
+
+private:
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    const char *m_name;
+    qint64 m_rows;
+    QElapsedTimer m_timer;
+};
+
+#endif // METRICS_H
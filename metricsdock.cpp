@@ -0,0 +1,103 @@
+#include "metricsdock.h"
+#include "metrics.h"
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QCheckBox>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QTimer>
+#include <QFileDialog>
+#include <QMessageBox>
+
+MetricsDock::MetricsDock(QWidget *parent)
+    : QDockWidget("性能指标", parent)
+{
+    setObjectName("MetricsDock");
+
+    QWidget *content = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(content);
+
+    QHBoxLayout *toolbar = new QHBoxLayout();
+    m_checkEnabled = new QCheckBox("启用采集");
+    m_checkEnabled->setChecked(Metrics::enabled());
+    QPushButton *btnReset = new QPushButton("清零");
+    QPushButton *btnDump = new QPushButton("导出...");
+    toolbar->addWidget(m_checkEnabled);
+    toolbar->addStretch();
+    toolbar->addWidget(btnReset);
+    toolbar->addWidget(btnDump);
+    layout->addLayout(toolbar);
+
+    m_table = new QTableWidget(0, 7);
+    m_table->setHorizontalHeaderLabels({"指标", "次数", "平均(ms)", "P50(ms)", "P95(ms)", "最大(ms)", "行/秒"});
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->verticalHeader()->setVisible(false);
+    m_table->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    layout->addWidget(m_table);
+
+    setWidget(content);
+
+    m_timer = new QTimer(this);
+    m_timer->setInterval(1000);
+
+    connect(m_timer, &QTimer::timeout, this, &MetricsDock::refresh);
+    connect(m_checkEnabled, &QCheckBox::toggled, this, &MetricsDock::onToggleEnabled);
+    connect(btnReset, &QPushButton::clicked, this, &MetricsDock::onReset);
+    connect(btnDump, &QPushButton::clicked, this, &MetricsDock::onDump);
+}
+
+//只在面板可见时刷新，隐藏后不占用界面线程
+void MetricsDock::showEvent(QShowEvent *event) {
+    QDockWidget::showEvent(event);
+    refresh();
+    m_timer->start();
+}
+
+void MetricsDock::hideEvent(QHideEvent *event) {
+    QDockWidget::hideEvent(event);
+    m_timer->stop();
+}
+
+void MetricsDock::refresh() {
+    const QList<MetricSample> list = Metrics::instance().samples();
+    m_table->setRowCount(list.size());
+
+    auto number = [](double v) { return new QTableWidgetItem(QString::number(v, 'f', 3)); };
+
+    for (int row = 0; row < list.size(); ++row) {
+        const MetricSample &s = list.at(row);
+        m_table->setItem(row, 0, new QTableWidgetItem(s.name));
+        m_table->setItem(row, 1, new QTableWidgetItem(QString::number(s.count)));
+        if (s.isCounter) {
+            for (int col = 2; col < 7; ++col)
+                m_table->setItem(row, col, new QTableWidgetItem("-"));
+            continue;
+        }
+        m_table->setItem(row, 2, number(s.avgMs()));
+        m_table->setItem(row, 3, number(s.p50Ms));
+        m_table->setItem(row, 4, number(s.p95Ms));
+        m_table->setItem(row, 5, number(s.maxMs));
+        m_table->setItem(row, 6, new QTableWidgetItem(s.rows > 0 ? QString::number(s.rowsPerSec(), 'f', 0) : "-"));
+    }
+}
+
+void MetricsDock::onToggleEnabled(bool on) {
+    Metrics::setEnabled(on);
+}
+
+void MetricsDock::onReset() {
+    Metrics::instance().reset();
+    refresh();
+}
+
+void MetricsDock::onDump() {
+    QString path = QFileDialog::getSaveFileName(this, "导出性能指标", "metrics.prom",
+                                                "Prometheus 文本 (*.prom *.txt);;JSON (*.json)");
+    if (path.isEmpty()) return;
+
+    if (!Metrics::instance().dumpToFile(path)) {
+        QMessageBox::critical(this, "错误", "无法写入文件");
+    }
+}
@@ -0,0 +1,33 @@
+#ifndef METRICSDOCK_H
+#define METRICSDOCK_H
+
+#include <QDockWidget>
+
+class QTableWidget;
+class QCheckBox;
+class QTimer;
+
+// 性能指标面板：定时刷新 Metrics 中的计数器与延迟统计
+class MetricsDock : public QDockWidget
+{
+    Q_OBJECT
+public:
+    explicit MetricsDock(QWidget *parent = nullptr);
+
+private slots:
+    void refresh();          // 刷新表格
+    void onToggleEnabled(bool on);
+    void onReset();
+    void onDump();           // 导出到文件 (Prometheus / JSON)
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    QTableWidget *m_table;
+    QCheckBox *m_checkEnabled;
+    QTimer *m_timer;
+};
+
+#endif // METRICSDOCK_H
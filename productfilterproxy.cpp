@@ -0,0 +1,44 @@
+#include "productfilterproxy.h"
+#include "productmodel.h"
+#include "lowstockmonitor.h"
+
+ProductFilterProxy::ProductFilterProxy(QObject *parent)
+    : QSortFilterProxyModel(parent), m_lowStockOnly(false), m_useMatchedIds(false)
+{
+    //有货品越过阈值时，只在"仅低库存"模式下需要重新过滤
+    connect(&LowStockMonitor::instance(), &LowStockMonitor::thresholdCrossed, this, [this]() {
+        if (m_lowStockOnly) invalidateFilter();
+    });
+    connect(&LowStockMonitor::instance(), &LowStockMonitor::reloaded, this, [this]() {
+        if (m_lowStockOnly) invalidateFilter();
+    });
+}
+
+void ProductFilterProxy::setLowStockOnly(bool on) {
+    if (m_lowStockOnly == on) return;
+    m_lowStockOnly = on;
+    invalidateFilter();
+}
+
+void ProductFilterProxy::setMatchedIds(const QSet<int> &ids) {
+    m_matchedIds = ids;
+    m_useMatchedIds = true;
+    invalidateFilter();
+}
+
+void ProductFilterProxy::clearMatchedIds() {
+    if (!m_useMatchedIds) return;
+    m_matchedIds.clear();
+    m_useMatchedIds = false;
+    invalidateFilter();
+}
+
+bool ProductFilterProxy::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const {
+    const ProductModel *model = qobject_cast<const ProductModel *>(sourceModel());
+    if (m_lowStockOnly) {
+        if (model && !LowStockMonitor::instance().isLow(model->productId(sourceRow)))
+            return false;
+    }
+    if (m_useMatchedIds && model) return m_matchedIds.contains(model->productId(sourceRow));
+    return QSortFilterProxyModel::filterAcceptsRow(sourceRow, sourceParent);
+}
@@ -0,0 +1,29 @@
+#ifndef PRODUCTFILTERPROXY_H
+#define PRODUCTFILTERPROXY_H
+
+#include <QSortFilterProxyModel>
+#include <QSet>
+
+// 库存表的过滤模型：在文本搜索的基础上支持"仅显示低库存"；
+// 全文索引可用时由 setMatchedIds() 给出命中的货品，不再逐行做子串匹配
+class ProductFilterProxy : public QSortFilterProxyModel
+{
+    Q_OBJECT
+public:
+    explicit ProductFilterProxy(QObject *parent = nullptr);
+
+    void setLowStockOnly(bool on);
+    bool lowStockOnly() const { return m_lowStockOnly; }
+    void setMatchedIds(const QSet<int> &ids);
+    void clearMatchedIds();
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+
+private:
+    bool m_lowStockOnly;
+    bool m_useMatchedIds;
+    QSet<int> m_matchedIds;
+};
+
+#endif // PRODUCTFILTERPROXY_H
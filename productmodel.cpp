@@ -1,24 +1,179 @@
 #include "productmodel.h"
 #include "dbmanager.h"
+#include "metrics.h"
+#include "lowstockmonitor.h"
+#include "forecaster.h"
 #include <QColor>
 #include <QBrush>
+#include <QFile>
+#include <QDataStream>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QtConcurrent>
 
 ProductModel::ProductModel(QObject *parent)
     : QAbstractTableModel(parent)
+    , m_generation(0)
+    , m_storeGeneration(0)
+    , m_loading(false)
+    , m_replaceOnNextPage(false)
 {
     //定义表头
-    m_headers << "ID" << "编号" << "名称" << "分类" << "单位" << "单价" << "当前库存" << "安全库存";
+    m_headers << "ID" << "编号" << "名称" << "分类" << "单位" << "单价" << "当前库存" << "安全库存" << "预计可用天数";
+}
+
+ProductModel::~ProductModel() {
+    //让后台加载尽快退出；已投递但未执行的分页随对象一起丢弃
+    ++m_generation;
+    m_loader.waitForFinished();
 }
 
 void ProductModel::reload() {
+    ScopedTimer timer("model_product_reload");
+    ++m_generation; // 作废进行中的后台加载
+    m_loading = false;
     beginResetModel();
-    m_products = DbManager::instance().getAllProducts();
+    m_snapshot = SnapshotStore::instance().acquire(false);
+    m_products.clear();
     endResetModel();
+    timer.setRows(count());
+}
+
+void ProductModel::reloadAsync() {
+    const int generation = ++m_generation;
+    m_loader.waitForFinished(); // 上一次的加载在下一页之前就会退出，最多等一页
+    m_loading = true;
+    m_replaceOnNextPage = true;
+    m_loadTimer.start();
+    m_storeGeneration = SnapshotStore::instance().productGeneration();
+
+    const QString path = DbManager::databasePath();
+    m_loader = QtConcurrent::run([this, generation, path] {
+        const QString name = QString("ProductLoader%1").arg(generation);
+        {
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+            db.setDatabaseName(path);
+            db.setConnectOptions("QSQLITE_OPEN_READONLY");
+            const bool opened = db.open();
+
+            //总数用来确认分页读全了（某一页查询出错时同样表现为"最后一页"）
+            int expected = -1;
+            QSqlQuery countQuery(db);
+            if (opened && countQuery.exec("SELECT count(*) FROM products WHERE deleted = 0") && countQuery.next())
+                expected = countQuery.value(0).toInt();
+            countQuery.clear();
+
+            int beforeId = -1;
+            int pageSize = FirstPageSize;
+            bool last = !opened;
+            while (!last && m_generation.load() == generation) {
+                QList<Product> page = DbManager::getProductsPage(db, beforeId, pageSize);
+                last = page.size() < pageSize;
+                if (!page.isEmpty()) beforeId = page.last().id;
+                pageSize = PageSize;
+                QMetaObject::invokeMethod(this, [this, generation, page, last, expected] {
+                    appendPage(generation, page, last, expected);
+                }, Qt::QueuedConnection);
+            }
+            if (!opened) {
+                QMetaObject::invokeMethod(this, [this, generation] {
+                    appendPage(generation, QList<Product>(), true, -1);
+                }, Qt::QueuedConnection);
+            }
+        }
+        QSqlDatabase::removeDatabase(name);
+    });
+}
+
+void ProductModel::appendPage(int generation, const QList<Product> &page, bool last, int expected) {
+    if (generation != m_generation.load()) return;
+
+    if (m_replaceOnNextPage) {
+        //第一页替换掉首屏缓存（或上一次的数据）
+        m_replaceOnNextPage = false;
+        beginResetModel();
+        m_snapshot.reset();
+        m_products = page;
+        endResetModel();
+    } else if (!page.isEmpty()) {
+        beginInsertRows(QModelIndex(), m_products.size(), m_products.size() + page.size() - 1);
+        m_products.append(page);
+        endInsertRows();
+    }
+
+    if (last) {
+        m_loading = false;
+        //完整读到的货品交给共享快照，之后的 reload() 和导出直接使用，不再在界面线程整表查库；
+        //行的内容和顺序不变，只是换了来源，不需要通知视图
+        if (m_products.size() == expected
+            && SnapshotStore::instance().adoptProducts(m_products, m_storeGeneration)) {
+            m_snapshot = SnapshotStore::instance().current();
+            m_products.clear();
+        }
+        if (Metrics::enabled())
+            Metrics::instance().observe("model_product_reload_async", m_loadTimer.nsecsElapsed(), count());
+        emit loadFinished();
+    }
+}
+
+void ProductModel::refreshForecast() {
+    if (count() > 0)
+        emit dataChanged(index(0, 8), index(count() - 1, 8));
+}
+
+//首屏缓存文件：魔数 + 版本 + 行数 + 各行字段
+static const quint32 CacheMagic = 0x57484653; // "WHFS"
+static const quint16 CacheVersion = 1;
+
+bool ProductModel::saveCache(const QString &path, int rows) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+    QDataStream out(&file);
+    const int n = qMin(rows, count());
+    out << CacheMagic << CacheVersion << qint32(n);
+    for (int i = 0; i < n; ++i) {
+        const Product &p = at(i);
+        out << qint32(p.id) << p.code << p.name << p.category << p.unit
+            << p.price << qint32(p.quantity) << qint32(p.minStock);
+    }
+    return out.status() == QDataStream::Ok;
+}
+
+bool ProductModel::loadCache(const QString &path) {
+    ScopedTimer timer("model_product_load_cache");
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    QDataStream in(&file);
+    quint32 magic = 0;
+    quint16 version = 0;
+    qint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != CacheMagic || version != CacheVersion || count < 0 || count > 100000) return false;
+
+    QList<Product> list;
+    list.reserve(count);
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Product p;
+        qint32 id, quantity, minStock;
+        in >> id >> p.code >> p.name >> p.category >> p.unit >> p.price >> quantity >> minStock;
+        p.id = id;
+        p.quantity = quantity;
+        p.minStock = minStock;
+        list.append(p);
+    }
+    if (in.status() != QDataStream::Ok) return false;
+
+    beginResetModel();
+    m_snapshot.reset();
+    m_products = list;
+    endResetModel();
+    timer.setRows(list.size());
+    return true;
 }
 
 int ProductModel::rowCount(const QModelIndex &parent) const {
     if (parent.isValid()) return 0;
-    return m_products.size();
+    return count();
 }
 
 int ProductModel::columnCount(const QModelIndex &parent) const {
@@ -27,33 +182,66 @@ int ProductModel::columnCount(const QModelIndex &parent) const {
 }
 
 QVariant ProductModel::data(const QModelIndex &index, int role) const {
-    if (!index.isValid() || index.row() >= m_products.size())
+    if (!index.isValid() || index.row() >= count())
         return QVariant();
 
-    const Product &p = m_products.at(index.row());
+    //库存数量始终取当前数据，其余字段叠加未保存的修改
+    const Product &base = at(index.row());
+    const Product &p = edited(index.row());
 
     //文本显示
     if (role == Qt::DisplayRole) {
         switch (index.column()) {
-        case 0: return p.id;
-        case 1: return p.code;
-        case 2: return p.name;
-        case 3: return p.category;
-        case 4: return p.unit;
-        case 5: return QString::number(p.price, 'f', 2); // 保留2位小数
-        case 6: return p.quantity;
-        case 7: return p.minStock;
+        case ColId: return p.id;
+        case ColCode: return p.code;
+        case ColName: return p.name;
+        case ColCategory: return p.category;
+        case ColUnit: return p.unit;
+        case ColPrice: return QString::number(p.price, 'f', 2); // 保留2位小数
+        case ColQuantity: return base.quantity;
+        case ColMinStock: return p.minStock;
+        case ColDaysLeft: {
+            // 按近期出库速度估算，无出库记录时留空
+            double days = Forecaster::instance().daysUntilStockout(p.id, base.quantity);
+            if (days < 0) return QVariant();
+            return qRound(days * 10) / 10.0;
         }
+        }
+    }
+    //编辑器里给原始值，单价不带格式
+    else if (role == Qt::EditRole) {
+        switch (index.column()) {
+        case ColName: return p.name;
+        case ColCategory: return p.category;
+        case ColUnit: return p.unit;
+        case ColPrice: return p.price;
+        case ColMinStock: return p.minStock;
+        }
+    }
+    //有未保存修改的行标浅黄
+    else if (role == Qt::BackgroundRole) {
+        if (&p != &base) return QBrush(QColor(255, 250, 205));
+    }
+    else if (role == Qt::ToolTipRole && index.column() == ColDaysLeft) {
+        const Forecaster &f = Forecaster::instance();
+        return QString("日均出库  7天: %1  30天: %2  90天: %3  平滑: %4")
+            .arg(f.rate7(p.id), 0, 'f', 2).arg(f.rate30(p.id), 0, 'f', 2)
+            .arg(f.rate90(p.id), 0, 'f', 2).arg(f.smoothedRate(p.id), 0, 'f', 2);
     }
     //库存预警颜色
     else if (role == Qt::ForegroundRole) {
-        // 如果当前库存 < 安全库存，整行文字变红
-        if (p.quantity < p.minStock) {
+        // 如果当前库存 < 安全库存，整行文字变红（由低库存监控增量维护，不在绘制时逐个比较）
+        if (LowStockMonitor::instance().isLow(p.id)) {
             return QBrush(Qt::red);
         }
+        // 预计一周内缺货的提前标橙
+        if (index.column() == ColDaysLeft) {
+            double days = Forecaster::instance().daysUntilStockout(p.id, base.quantity);
+            if (days >= 0 && days < 7) return QBrush(QColor(255, 140, 0));
+        }
     }
     else if (role == Qt::TextAlignmentRole) {
-        if (index.column() >= 5)
+        if (index.column() >= ColPrice)
             return QVariant(Qt::AlignCenter);
         return QVariant(Qt::AlignLeft | Qt::AlignVCenter);
     }
@@ -69,8 +257,161 @@ QVariant ProductModel::headerData(int section, Qt::Orientation orientation, int
 }
 
 Product ProductModel::getProduct(int row) {
-    if (row >= 0 && row < m_products.size())
-        return m_products.at(row);
+    if (row >= 0 && row < count())
+        return at(row);
     return Product();
 }
 
+//修改的暂存与批量应用
+
+//单价按分保存，批量调价后不出现 0.1 + 0.2 这类尾差
+static double roundPrice(double price) {
+    return qRound64(price * 100) / 100.0;
+}
+
+static bool sameFields(const Product &a, const Product &b) {
+    return a.code == b.code && a.name == b.name && a.category == b.category
+        && a.unit == b.unit && a.price == b.price && a.minStock == b.minStock;
+}
+
+//把 value 写到 p 的对应列，值不合法时返回 false
+static bool assignColumn(Product *p, int column, const QVariant &value) {
+    switch (column) {
+    case ProductModel::ColName: {
+        const QString name = value.toString().trimmed();
+        if (name.isEmpty()) return false;
+        p->name = name;
+        return true;
+    }
+    case ProductModel::ColCategory: p->category = value.toString().trimmed(); return true;
+    case ProductModel::ColUnit: p->unit = value.toString().trimmed(); return true;
+    case ProductModel::ColPrice: {
+        bool ok = false;
+        const double price = value.toDouble(&ok);
+        if (!ok || price < 0) return false;
+        p->price = roundPrice(price);
+        return true;
+    }
+    case ProductModel::ColMinStock: {
+        bool ok = false;
+        const int minStock = value.toInt(&ok);
+        if (!ok || minStock < 0) return false;
+        p->minStock = minStock;
+        return true;
+    }
+    }
+    return false;
+}
+
+const Product &ProductModel::edited(int row) const {
+    const Product &base = at(row);
+    if (m_pending.isEmpty()) return base;
+    auto it = m_pending.constFind(base.id);
+    return it == m_pending.constEnd() ? base : it.value();
+}
+
+bool ProductModel::stage(int row, const Product &p) {
+    if (sameFields(p, edited(row))) return false;
+    const Product &base = at(row);
+    if (sameFields(p, base)) m_pending.remove(base.id); // 改回了原值
+    else m_pending.insert(base.id, p);
+    return true;
+}
+
+Qt::ItemFlags ProductModel::flags(const QModelIndex &index) const {
+    Qt::ItemFlags f = QAbstractTableModel::flags(index);
+    if (index.isValid() && isEditableColumn(index.column())) f |= Qt::ItemIsEditable;
+    return f;
+}
+
+bool ProductModel::setData(const QModelIndex &index, const QVariant &value, int role) {
+    if (role != Qt::EditRole || !index.isValid() || index.row() >= count()
+        || !isEditableColumn(index.column()))
+        return false;
+
+    Product p = edited(index.row());
+    if (!assignColumn(&p, index.column(), value)) return false;
+    if (stage(index.row(), p)) {
+        //整行的底色可能变化
+        emit dataChanged(this->index(index.row(), 0), this->index(index.row(), columnCount() - 1));
+        emit pendingChanged(m_pending.size());
+    }
+    return true;
+}
+
+//逐行修改后只发一次 dataChanged，几万行的批量修改不会让视图逐行刷新
+int ProductModel::editRows(const QList<int> &rows, const std::function<void(Product *)> &edit) {
+    ScopedTimer timer("model_product_bulk_edit");
+    int changed = 0;
+    int first = count();
+    int last = -1;
+    for (int row : rows) {
+        if (row < 0 || row >= count()) continue;
+        Product p = edited(row);
+        edit(&p);
+        if (!stage(row, p)) continue;
+        ++changed;
+        first = qMin(first, row);
+        last = qMax(last, row);
+    }
+    timer.setRows(rows.size());
+    if (changed > 0) {
+        emit dataChanged(index(first, 0), index(last, columnCount() - 1));
+        emit pendingChanged(m_pending.size());
+    }
+    return changed;
+}
+
+int ProductModel::setRowsData(const QList<int> &rows, int column, const QVariant &value) {
+    Product probe;
+    if (!isEditableColumn(column) || !assignColumn(&probe, column, value)) return 0;
+    return editRows(rows, [column, &value](Product *p) { assignColumn(p, column, value); });
+}
+
+int ProductModel::scalePrices(const QList<int> &rows, double percent) {
+    const double factor = 1.0 + percent / 100.0;
+    if (factor < 0) return 0;
+    return editRows(rows, [factor](Product *p) { p->price = roundPrice(p->price * factor); });
+}
+
+QList<Product> ProductModel::pendingChanges(QList<Product> *original, int *missing) const {
+    QList<Product> list;
+    if (original) original->clear();
+    if (missing) *missing = 0;
+    if (m_pending.isEmpty()) return list;
+    //表中按 ID 倒序，倒着扫一遍即为升序，写库时按主键顺序访问
+    for (int row = count() - 1; row >= 0; --row) {
+        const Product &base = at(row);
+        auto it = m_pending.constFind(base.id);
+        if (it == m_pending.constEnd()) continue;
+        Product p = it.value();
+        p.quantity = base.quantity;
+        list.append(p);
+        if (original) original->append(base);
+    }
+    if (missing) *missing = m_pending.size() - list.size();
+    return list;
+}
+
+Product ProductModel::editedProduct(int row) const {
+    if (row < 0 || row >= count()) return Product();
+    Product p = edited(row);
+    p.quantity = at(row).quantity;
+    return p;
+}
+
+void ProductModel::discardPending(int productId) {
+    if (!m_pending.remove(productId)) return;
+    if (count() > 0)
+        emit dataChanged(index(0, 0), index(count() - 1, columnCount() - 1));
+    emit pendingChanged(m_pending.size());
+}
+
+void ProductModel::clearPending() {
+    if (m_pending.isEmpty()) return;
+    m_pending.clear();
+    if (count() > 0)
+        emit dataChanged(index(0, 0), index(count() - 1, columnCount() - 1));
+    emit pendingChanged(0);
+}
+
@@ -3,13 +3,26 @@
 
 #include <QAbstractTableModel>
 #include <QList>
+#include <QFuture>
+#include <QElapsedTimer>
+#include <QHash>
+#include <atomic>
+#include <functional>
 #include "warehousedata.h"
+#include "datasnapshot.h"
 
 class ProductModel : public QAbstractTableModel
 {
     Q_OBJECT
 public:
+    static const int FirstPageSize = 200; // 第一页尽量小，尽快出现在界面上
+    static const int PageSize = 5000;
+
+    // 表格列（与表头顺序一致）
+    enum Column { ColId, ColCode, ColName, ColCategory, ColUnit, ColPrice, ColQuantity, ColMinStock, ColDaysLeft };
+
     explicit ProductModel(QObject *parent = nullptr);
+    ~ProductModel() override;
 
     // 标准 Model 必须重写的函数
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -17,12 +30,63 @@ public:
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
+    // 直接编辑：名称、分类、单位、单价、安全库存可在表格中修改（编号和库存数量不可改）
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+
+    // 修改先按货品ID记在内存里，不立即写库；重新加载后未保存的修改仍然叠加显示，
+    // 由调用方取出后一次批量写入（DbManager::updateProductsBatch）
+    int setRowsData(const QList<int> &rows, int column, const QVariant &value); // 多行同一列设为同一个值，返回实际改动的行数
+    int scalePrices(const QList<int> &rows, double percent); // 多行单价按百分比调整（-10 表示降价 10%）
+    bool hasPendingChanges() const { return !m_pending.isEmpty(); }
+    int pendingCount() const { return m_pending.size(); }
+    // 未保存的修改，按货品ID升序；original 非空时同时给出对应的当前资料（撤销用）
+    // 已不在表中的货品（如已被删除）不返回，missing 非空时给出这类修改的个数
+    QList<Product> pendingChanges(QList<Product> *original = nullptr, int *missing = nullptr) const;
+    void clearPending(); // 保存成功或放弃修改后调用
+    Product editedProduct(int row) const; // 叠加了未保存修改的一行（库存数量为当前值）
+    void discardPending(int productId);   // 去掉一个货品的未保存修改（已通过对话框直接保存时）
+
     // 自定义功能
-    void reload();          // 从数据库重新加载数据
+    void reload();          // 切换到最新的共享快照（已加载时不查库）
+    void reloadAsync();     // 后台线程分页加载：第一页到达时替换当前内容，其余页依次追加
+    bool isLoading() const { return m_loading; }
+    void refreshForecast(); // 补货预测重新计算后刷新"预计可用天数"列
+
+    // 首屏缓存：退出时保存前若干行，下次启动时在后台加载完成前先显示
+    bool saveCache(const QString &path, int rows = FirstPageSize) const;
+    bool loadCache(const QString &path);
     Product getProduct(int row); // 获取某一行的数据（用于编辑或出入库选择）
+    int productId(int row) const { return (row >= 0 && row < count()) ? at(row).id : -1; }
+
+signals:
+    void loadFinished(); // reloadAsync() 的全部分页已到达
+    void pendingChanged(int count); // 未保存的修改数变化
 
 private:
+    void appendPage(int generation, const QList<Product> &page, bool last, int expected); // expected: 货品总数，未知时为 -1
+    static bool isEditableColumn(int column) {
+        return (column >= ColName && column <= ColPrice) || column == ColMinStock;
+    }
+    const Product &edited(int row) const; // 叠加了未保存修改的行数据
+    bool stage(int row, const Product &p); // 记下一行的修改，返回显示内容是否变化
+    int editRows(const QList<int> &rows, const std::function<void(Product *)> &edit);
+
+    // 行数据来自共享快照（ID 倒序显示）；启动时的首屏缓存和后台分页加载期间来自 m_products
+    int count() const { return m_snapshot ? m_snapshot->products.size() : m_products.size(); }
+    const Product &at(int row) const {
+        return m_snapshot ? m_snapshot->products.at(m_snapshot->products.size() - 1 - row) : m_products.at(row);
+    }
+
+    DataSnapshotPtr m_snapshot;
     QList<Product> m_products;
+    QHash<int, Product> m_pending; // 货品ID -> 修改后的资料
+    QFuture<void> m_loader;
+    std::atomic<int> m_generation; // 每次重新加载加一，旧的后台加载据此放弃
+    quint64 m_storeGeneration;     // 后台加载开始时共享快照的货品修改代数
+    bool m_loading;
+    bool m_replaceOnNextPage;
+    QElapsedTimer m_loadTimer;
     QStringList m_headers;
 };
 
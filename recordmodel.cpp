@@ -1,23 +1,55 @@
 #include "recordmodel.h"
 #include "dbmanager.h"
+#include "metrics.h"
 #include <QColor>
 #include <QBrush>
 
 RecordModel::RecordModel(QObject *parent)
-    : QAbstractTableModel(parent)
+    : QAbstractTableModel(parent), m_atEnd(true)
 {
-    m_headers << "时间" << "类型" << "货品名称" << "变动数量" << "备注";
+    m_headers << "时间" << "类型" << "货品名称" << "仓库" << "变动数量" << "备注";
 }
 
 void RecordModel::reload() {
+    ScopedTimer timer("model_record_reload");
     beginResetModel();
-    m_records = DbManager::instance().getAllRecords();
+    if (m_search.isEmpty()) {
+        m_snapshot = SnapshotStore::instance().acquire(true);
+        m_records.clear();
+        m_atEnd = true;
+    } else {
+        m_snapshot.reset();
+        m_records = DbManager::instance().searchRecords(m_search, 0, SearchPageSize);
+        m_atEnd = m_records.size() < SearchPageSize;
+    }
     endResetModel();
+    timer.setRows(count());
+}
+
+void RecordModel::setSearch(const QString &text) {
+    m_search = text.trimmed();
+    reload();
+}
+
+bool RecordModel::canFetchMore(const QModelIndex &parent) const {
+    return !parent.isValid() && !m_atEnd;
+}
+
+//搜索结果滚动到底部时再取下一页
+void RecordModel::fetchMore(const QModelIndex &parent) {
+    if (parent.isValid() || m_atEnd) return;
+    const QList<Record> page = DbManager::instance().searchRecords(m_search, m_records.size(), SearchPageSize);
+    if (page.size() < SearchPageSize) m_atEnd = true;
+    if (page.isEmpty()) return;
+
+    beginInsertRows(QModelIndex(), m_records.size(), m_records.size() + page.size() - 1);
+    m_records.append(page);
+    endInsertRows();
 }
 
 int RecordModel::rowCount(const QModelIndex &parent) const {
     if (parent.isValid()) return 0;
-    return m_records.size();
+    return count();
 }
 
 int RecordModel::columnCount(const QModelIndex &parent) const {
@@ -26,18 +58,19 @@ int RecordModel::columnCount(const QModelIndex &parent) const {
 }
 
 QVariant RecordModel::data(const QModelIndex &index, int role) const {
-    if (!index.isValid() || index.row() >= m_records.size())
+    if (!index.isValid() || index.row() >= count())
         return QVariant();
 
-    const Record &r = m_records.at(index.row());
+    const Record &r = at(index.row());
 
     if (role == Qt::DisplayRole) {
         switch (index.column()) {
         case 0: return r.time.toString("yyyy-MM-dd HH:mm:ss");
         case 1: return r.typeStr();
         case 2: return r.productName;
-        case 3: return r.count;
-        case 4: return r.remark;
+        case 3: return r.locationName;
+        case 4: return r.count;
+        case 5: return r.remark;
         }
     }
     else if (role == Qt::ForegroundRole) {
@@ -4,11 +4,16 @@
 #include <QAbstractTableModel>
 #include <QList>
 #include "warehousedata.h"
+#include "datasnapshot.h"
 
+// 历史记录：没有搜索词时显示共享快照中的全部记录（最新在前，刷新只是换一个快照指针）；
+// 有搜索词时走全文索引，按相关度分页加载
 class RecordModel : public QAbstractTableModel
 {
     Q_OBJECT
 public:
+    static const int SearchPageSize = 200;
+
     explicit RecordModel(QObject *parent = nullptr);
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
@@ -17,9 +22,22 @@ public:
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
 
     void reload();
+    void setSearch(const QString &text); // 设置搜索词并重新加载（空字符串表示全部记录）
+    QString search() const { return m_search; }
+
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 
 private:
-    QList<Record> m_records;
+    int count() const { return m_search.isEmpty() ? (m_snapshot ? m_snapshot->records.size() : 0) : m_records.size(); }
+    const Record &at(int row) const {
+        return m_search.isEmpty() ? m_snapshot->records.at(m_snapshot->records.size() - 1 - row) : m_records.at(row);
+    }
+
+    DataSnapshotPtr m_snapshot;
+    QList<Record> m_records; // 搜索结果
+    QString m_search;
+    bool m_atEnd;
     QStringList m_headers;
 };
 
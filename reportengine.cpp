@@ -0,0 +1,367 @@
+#include "reportengine.h"
+#include "metrics.h"
+#include "datasnapshot.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QFuture>
+#include <QtConcurrent>
+#include <QDebug>
+#include <QMap>
+#include <algorithm>
+#include <numeric>
+
+static const int MinChunk = 16384; // 每块最少行数，太小的块不值得开线程
+
+//把 [first, last) 切成若干块并行执行 fn(begin, end)，按块顺序返回各块的局部结果
+template <typename Partial, typename Fn>
+static QList<Partial> runChunks(int first, int last, Fn fn) {
+    const int count = last - first;
+    const int threads = qMax(1, QThread::idealThreadCount());
+    const int size = qMax(MinChunk, (count + threads - 1) / qMax(1, threads));
+
+    QList<Partial> results;
+    if (count <= size) {
+        results << fn(first, last);
+        return results;
+    }
+    QList<QFuture<Partial>> futures;
+    for (int begin = first; begin < last; begin += size) {
+        const int end = qMin(begin + size, last);
+        futures << QtConcurrent::run([fn, begin, end]() { return fn(begin, end); });
+    }
+    for (QFuture<Partial> &f : futures) results << f.result();
+    return results;
+}
+
+ReportEngine::ReportEngine() : m_loaded(false), m_utcOffset(0) {}
+
+ReportEngine& ReportEngine::instance() {
+    static ReportEngine instance;
+    return instance;
+}
+
+void ReportEngine::invalidateAll() {
+    m_loaded = false;
+    m_cache.clear();
+}
+
+void ReportEngine::ensureLoaded() {
+    if (m_loaded) return;
+    ScopedTimer timer("report_load_columns");
+    m_utcOffset = QDateTime::currentDateTime().offsetFromUtc();
+
+    m_slots.clear();
+    m_productId.clear();
+    m_productLabel.clear();
+    m_category.clear();
+    m_categoryNames.clear();
+    m_price.clear();
+    m_quantity.clear();
+    m_ts.clear();
+    m_recSlot.clear();
+    m_delta.clear();
+
+    //货品部分取自共享快照（库存表加载过时不再查库）；记录只读报表需要的 4 列，
+    //不为报表把全部记录以完整的 Record 形式载入共享快照常驻内存
+    const DataSnapshotPtr snapshot = SnapshotStore::instance().acquire(false);
+
+    QHash<QString, int> categoryIndex;
+    for (int i = 0; i < snapshot->products.size(); ++i) {
+        const Product &p = snapshot->products.at(i);
+        auto it = categoryIndex.constFind(p.category);
+        if (it == categoryIndex.constEnd()) {
+            it = categoryIndex.insert(p.category, m_categoryNames.size());
+            m_categoryNames << p.category;
+        }
+        m_slots.insert(p.id, m_productId.size());
+        m_productId << p.id;
+        m_productLabel << p.code + " " + p.name;
+        m_category << it.value();
+        m_price << p.price;
+        m_quantity << p.quantity;
+    }
+
+    //仓库间调拨成对出现、总量不变，不计入出入库报表
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    query.exec("SELECT product_id, type, count, timestamp FROM records "
+               "WHERE peer_location_id = 0 ORDER BY timestamp");
+    while (query.next()) {
+        m_recSlot << m_slots.value(query.value(0).toInt(), -1);
+        const int count = query.value(2).toInt();
+        m_delta << (query.value(1).toInt() == 1 ? count : -count);
+        m_ts << query.value(3).toLongLong();
+    }
+
+    m_cache.clear();
+    m_loaded = true;
+    timer.setRows(m_productId.size() + m_ts.size());
+}
+
+bool ReportEngine::lookup(const QString &key, ReportTable *table) {
+    auto it = m_cache.constFind(key);
+    if (it == m_cache.constEnd()) {
+        Metrics::count("report_cache_misses_total");
+        return false;
+    }
+    Metrics::count("report_cache_hits_total");
+    *table = it.value().table;
+    table->fromCache = true;
+    return true;
+}
+
+void ReportEngine::store(const QString &key, const ReportTable &table, qint64 from, qint64 to, bool dependsOnStock) {
+    m_cache.insert(key, {table, from, to, dependsOnStock});
+}
+
+void ReportEngine::onMovement(int productId, bool isInbound, int count, qint64 timestamp, int newQuantity) {
+    if (!m_loaded) return;
+
+    const int slot = m_slots.value(productId, -1);
+    if (slot < 0) {
+        //新货品尚未进入快照，下次重新加载
+        invalidateAll();
+        return;
+    }
+    m_quantity[slot] = newQuantity;
+
+    //保持记录按时间有序：通常就是追加到末尾
+    const int pos = int(std::upper_bound(m_ts.constBegin(), m_ts.constEnd(), timestamp) - m_ts.constBegin());
+    m_ts.insert(pos, timestamp);
+    m_recSlot.insert(pos, slot);
+    m_delta.insert(pos, isInbound ? count : -count);
+
+    //只失效受影响的缓存：依赖库存的，以及时间范围覆盖这条记录的
+    for (auto it = m_cache.begin(); it != m_cache.end();) {
+        const CacheEntry &e = it.value();
+        if (e.dependsOnStock || (timestamp >= e.from && timestamp <= e.to))
+            it = m_cache.erase(it);
+        else
+            ++it;
+    }
+}
+
+void ReportEngine::recordRange(qint64 from, qint64 to, int *begin, int *end) const {
+    *begin = int(std::lower_bound(m_ts.constBegin(), m_ts.constEnd(), from) - m_ts.constBegin());
+    *end = int(std::upper_bound(m_ts.constBegin(), m_ts.constEnd(), to) - m_ts.constBegin());
+}
+
+void ReportEngine::aggregateByProduct(int begin, int end, QVector<qint64> *inbound, QVector<qint64> *outbound) const {
+    struct Partial { QVector<qint64> in, out; };
+    const int n = m_productId.size();
+    const qint32 *delta = m_delta.constData();
+    const int *slots = m_recSlot.constData();
+
+    const QList<Partial> partials = runChunks<Partial>(begin, end, [=](int b, int e) {
+        Partial p;
+        p.in = QVector<qint64>(n, 0);
+        p.out = QVector<qint64>(n, 0);
+        qint64 *in = p.in.data();
+        qint64 *out = p.out.data();
+        for (int i = b; i < e; ++i) {
+            const int s = slots[i];
+            if (s < 0) continue;
+            const qint32 d = delta[i];
+            if (d > 0) in[s] += d;
+            else out[s] -= d;
+        }
+        return p;
+    });
+
+    *inbound = QVector<qint64>(n, 0);
+    *outbound = QVector<qint64>(n, 0);
+    for (const Partial &p : partials) {
+        for (int s = 0; s < n; ++s) {
+            (*inbound)[s] += p.in.at(s);
+            (*outbound)[s] += p.out.at(s);
+        }
+    }
+}
+
+//库存货值（按分类）
+ReportTable ReportEngine::stockValueByCategory() {
+    ReportTable table;
+    const QString key = "value_by_category";
+    if (lookup(key, &table)) return table;
+
+    QElapsedTimer timer;
+    timer.start();
+    ensureLoaded();
+
+    struct Partial { QVector<qint64> sku, qty; QVector<double> value; };
+    const int categories = m_categoryNames.size();
+    const QList<Partial> partials = runChunks<Partial>(0, m_productId.size(), [this, categories](int b, int e) {
+        Partial p;
+        p.sku = QVector<qint64>(categories, 0);
+        p.qty = QVector<qint64>(categories, 0);
+        p.value = QVector<double>(categories, 0.0);
+        for (int i = b; i < e; ++i) {
+            const int c = m_category.at(i);
+            p.sku[c]++;
+            p.qty[c] += m_quantity.at(i);
+            p.value[c] += m_quantity.at(i) * m_price.at(i);
+        }
+        return p;
+    });
+
+    QVector<qint64> sku(categories, 0), qty(categories, 0);
+    QVector<double> value(categories, 0.0);
+    for (const Partial &p : partials) {
+        for (int c = 0; c < categories; ++c) {
+            sku[c] += p.sku.at(c);
+            qty[c] += p.qty.at(c);
+            value[c] += p.value.at(c);
+        }
+    }
+
+    QVector<int> order(categories);
+    for (int c = 0; c < categories; ++c) order[c] = c;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return value.at(a) > value.at(b); });
+
+    table.headers << "分类" << "货品数" << "库存总量" << "货值";
+    double total = 0;
+    for (int c : order) {
+        table.rows << QVariantList{m_categoryNames.at(c), sku.at(c), qty.at(c), QString::number(value.at(c), 'f', 2)};
+        total += value.at(c);
+    }
+    table.rows << QVariantList{"合计", m_productId.size(), std::accumulate(qty.constBegin(), qty.constEnd(), qint64(0)),
+                               QString::number(total, 'f', 2)};
+
+    table.elapsedUs = timer.nsecsElapsed() / 1000;
+    store(key, table, 0, -1, true);
+    return table;
+}
+
+//出入库汇总（按期间）：先并行按天聚合，再把天归并到周 / 月
+ReportTable ReportEngine::movementsByPeriod(ReportPeriod period, const QDateTime &from, const QDateTime &to) {
+    ReportTable table;
+    const qint64 f = from.toSecsSinceEpoch(), t = to.toSecsSinceEpoch();
+    const QString key = QString("period_%1_%2_%3").arg(int(period)).arg(f).arg(t);
+    if (lookup(key, &table)) return table;
+
+    QElapsedTimer timer;
+    timer.start();
+    ensureLoaded();
+
+    int begin, end;
+    recordRange(f, t, &begin, &end);
+
+    struct DayTotals { qint64 in = 0, out = 0; };
+    typedef QHash<qint64, DayTotals> Partial;
+    const qint64 offset = m_utcOffset;
+    const QList<Partial> partials = runChunks<Partial>(begin, end, [this, offset](int b, int e) {
+        Partial p;
+        for (int i = b; i < e; ++i) {
+            DayTotals &d = p[(m_ts.at(i) + offset) / 86400];
+            const qint32 delta = m_delta.at(i);
+            if (delta > 0) d.in += delta;
+            else d.out -= delta;
+        }
+        return p;
+    });
+
+    //合并各块，并把"自纪元起的天数"换算成期间
+    QMap<qint64, DayTotals> byPeriod;
+    QMap<qint64, QString> labels;
+    for (const Partial &p : partials) {
+        for (auto it = p.constBegin(); it != p.constEnd(); ++it) {
+            const QDate date = QDate(1970, 1, 1).addDays(it.key());
+            qint64 periodKey = 0;
+            QString label;
+            switch (period) {
+            case ReportPeriod::Day:
+                periodKey = it.key();
+                label = date.toString("yyyy-MM-dd");
+                break;
+            case ReportPeriod::Week: {
+                const QDate monday = date.addDays(1 - date.dayOfWeek());
+                periodKey = monday.toJulianDay();
+                label = monday.toString("yyyy-MM-dd") + " 周";
+                break;
+            }
+            case ReportPeriod::Month:
+                periodKey = date.year() * 12 + date.month();
+                label = date.toString("yyyy-MM");
+                break;
+            }
+            DayTotals &d = byPeriod[periodKey];
+            d.in += it.value().in;
+            d.out += it.value().out;
+            labels.insert(periodKey, label);
+        }
+    }
+
+    table.headers << "期间" << "入库量" << "出库量" << "净变动";
+    for (auto it = byPeriod.constBegin(); it != byPeriod.constEnd(); ++it)
+        table.rows << QVariantList{labels.value(it.key()), it.value().in, it.value().out, it.value().in - it.value().out};
+
+    table.elapsedUs = timer.nsecsElapsed() / 1000;
+    store(key, table, f, t, false);
+    return table;
+}
+
+//出入库汇总（按货品）
+ReportTable ReportEngine::movementsByProduct(const QDateTime &from, const QDateTime &to) {
+    ReportTable table;
+    const qint64 f = from.toSecsSinceEpoch(), t = to.toSecsSinceEpoch();
+    const QString key = QString("product_%1_%2").arg(f).arg(t);
+    if (lookup(key, &table)) return table;
+
+    QElapsedTimer timer;
+    timer.start();
+    ensureLoaded();
+
+    int begin, end;
+    recordRange(f, t, &begin, &end);
+    QVector<qint64> inbound, outbound;
+    aggregateByProduct(begin, end, &inbound, &outbound);
+
+    table.headers << "货品" << "入库量" << "出库量" << "净变动" << "当前库存";
+    for (int s = 0; s < m_productId.size(); ++s) {
+        if (inbound.at(s) == 0 && outbound.at(s) == 0) continue;
+        table.rows << QVariantList{m_productLabel.at(s), inbound.at(s), outbound.at(s),
+                                   inbound.at(s) - outbound.at(s), m_quantity.at(s)};
+    }
+
+    table.elapsedUs = timer.nsecsElapsed() / 1000;
+    store(key, table, f, t, true);
+    return table;
+}
+
+//出入库排行：按 入库量 + 出库量 取前 limit 个
+ReportTable ReportEngine::topMovers(const QDateTime &from, const QDateTime &to, int limit) {
+    ReportTable table;
+    const qint64 f = from.toSecsSinceEpoch(), t = to.toSecsSinceEpoch();
+    const QString key = QString("top_%1_%2_%3").arg(f).arg(t).arg(limit);
+    if (lookup(key, &table)) return table;
+
+    QElapsedTimer timer;
+    timer.start();
+    ensureLoaded();
+
+    int begin, end;
+    recordRange(f, t, &begin, &end);
+    QVector<qint64> inbound, outbound;
+    aggregateByProduct(begin, end, &inbound, &outbound);
+
+    QVector<int> order;
+    for (int s = 0; s < m_productId.size(); ++s)
+        if (inbound.at(s) + outbound.at(s) > 0) order << s;
+    const int n = qMin(limit, order.size());
+    std::partial_sort(order.begin(), order.begin() + n, order.end(), [&](int a, int b) {
+        return inbound.at(a) + outbound.at(a) > inbound.at(b) + outbound.at(b);
+    });
+
+    table.headers << "排名" << "货品" << "总变动量" << "入库量" << "出库量";
+    for (int i = 0; i < n; ++i) {
+        const int s = order.at(i);
+        table.rows << QVariantList{i + 1, m_productLabel.at(s), inbound.at(s) + outbound.at(s),
+                                   inbound.at(s), outbound.at(s)};
+    }
+
+    table.elapsedUs = timer.nsecsElapsed() / 1000;
+    store(key, table, f, t, false);
+    return table;
+}
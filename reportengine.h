@@ -0,0 +1,85 @@
+#ifndef REPORTENGINE_H
+#define REPORTENGINE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QVector>
+#include <QHash>
+#include <QVariant>
+#include <QDateTime>
+
+// 报表结果：表头 + 行，供界面直接展示
+struct ReportTable {
+    QStringList headers;
+    QList<QVariantList> rows;
+    qint64 elapsedUs = 0;   // 计算耗时
+    bool fromCache = false; // 是否命中缓存
+};
+
+enum class ReportPeriod {
+    Day,
+    Week,
+    Month
+};
+
+// 报表引擎：在内存列快照上做并行分组聚合
+// 货品和记录按列加载一次（首次出报表时），聚合时按线程切块，每块先在本地累加，
+// 最后合并。结果按参数缓存；新的出入库只追加到列快照，并只让时间范围覆盖到它的
+// 缓存失效；货品资料变化或批量导入后整体重建。
+// 只在界面线程中使用。
+class ReportEngine
+{
+public:
+    static ReportEngine& instance();
+
+    ReportTable stockValueByCategory();
+    ReportTable movementsByPeriod(ReportPeriod period, const QDateTime &from, const QDateTime &to);
+    ReportTable movementsByProduct(const QDateTime &from, const QDateTime &to);
+    ReportTable topMovers(const QDateTime &from, const QDateTime &to, int limit);
+
+    // 出入库提交后调用：追加到列快照并失效相关缓存
+    void onMovement(int productId, bool isInbound, int count, qint64 timestamp, int newQuantity);
+    // 货品资料变化 / 导入后调用：下次出报表时重新加载
+    void invalidateAll();
+
+private:
+    ReportEngine();
+    ReportEngine(const ReportEngine&) = delete;
+    ReportEngine& operator=(const ReportEngine&) = delete;
+
+    struct CacheEntry {
+        ReportTable table;
+        qint64 from;          // 依赖的记录时间范围
+        qint64 to;
+        bool dependsOnStock;  // 是否依赖当前库存数量
+    };
+
+    void ensureLoaded();
+    bool lookup(const QString &key, ReportTable *table);
+    void store(const QString &key, const ReportTable &table, qint64 from, qint64 to, bool dependsOnStock);
+    void recordRange(qint64 from, qint64 to, int *begin, int *end) const; // 时间范围 -> 记录下标区间
+    // 按货品汇总入库/出库量（并行）
+    void aggregateByProduct(int begin, int end, QVector<qint64> *inbound, QVector<qint64> *outbound) const;
+
+    bool m_loaded;
+    qint64 m_utcOffset;
+
+    // 货品列
+    QHash<int, int> m_slots;           // 货品ID -> 行号
+    QVector<int> m_productId;
+    QVector<QString> m_productLabel;   // "编号 名称"
+    QVector<int> m_category;           // 分类字典下标
+    QStringList m_categoryNames;
+    QVector<double> m_price;
+    QVector<qint64> m_quantity;
+
+    // 记录列（按时间升序）
+    QVector<qint64> m_ts;
+    QVector<int> m_recSlot;            // 对应的货品行号，-1 表示货品已不存在
+    QVector<qint32> m_delta;           // 入库为正，出库为负
+
+    QHash<QString, CacheEntry> m_cache;
+};
+
+#endif // REPORTENGINE_H
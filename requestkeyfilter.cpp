@@ -0,0 +1,84 @@
+#include "requestkeyfilter.h"
+#include "metrics.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QHash>
+#include <QDebug>
+
+RequestKeyFilter::RequestKeyFilter()
+    : m_loaded(false), m_bitCount(0), m_keyCount(0), m_capacity(0), m_ringPos(0) {}
+
+RequestKeyFilter& RequestKeyFilter::instance() {
+    static RequestKeyFilter instance;
+    return instance;
+}
+
+void RequestKeyFilter::ensureLoaded() {
+    if (m_loaded && m_keyCount <= m_capacity) return;
+    ScopedTimer timer("request_key_filter_reload");
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    qint64 existing = 0;
+    if (query.exec("SELECT count(*) FROM records WHERE request_key IS NOT NULL") && query.next())
+        existing = query.value(0).toLongLong();
+
+    //预留一倍余量，每个键 10 bit
+    m_capacity = qMax<qint64>(100000, existing * 2);
+    m_bitCount = quint64(m_capacity) * 10;
+    m_bits.fill(0, int((m_bitCount + 63) / 64));
+    m_keyCount = 0;
+    m_recent.clear();
+    m_ring.fill(QString(), WindowSize);
+    m_ringPos = 0;
+
+    //按 id 顺序加载，最后加载的即最近的键，正好留在窗口里
+    if (!query.exec("SELECT request_key FROM records WHERE request_key IS NOT NULL ORDER BY id"))
+        qDebug() << "Load Request Keys Error:" << query.lastError();
+    m_loaded = true;
+    while (query.next()) add(query.value(0).toString());
+    timer.setRows(m_keyCount);
+}
+
+//双重哈希：第 i 个位置为 h1 + i * h2
+void RequestKeyFilter::setBits(const QString &key) {
+    const quint64 h1 = qHash(key, 0x9e3779b9u);
+    const quint64 h2 = qHash(key, 0x85ebca6bu) | 1;
+    for (int i = 0; i < HashCount; ++i) {
+        const quint64 bit = (h1 + i * h2) % m_bitCount;
+        m_bits[int(bit / 64)] |= quint64(1) << (bit % 64);
+    }
+}
+
+bool RequestKeyFilter::testBits(const QString &key) const {
+    const quint64 h1 = qHash(key, 0x9e3779b9u);
+    const quint64 h2 = qHash(key, 0x85ebca6bu) | 1;
+    for (int i = 0; i < HashCount; ++i) {
+        const quint64 bit = (h1 + i * h2) % m_bitCount;
+        if (!(m_bits.at(int(bit / 64)) & (quint64(1) << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+RequestKeyFilter::Result RequestKeyFilter::check(const QString &key) {
+    ensureLoaded();
+    if (m_recent.contains(key)) {
+        Metrics::count("request_key_window_hits_total");
+        return Duplicate;
+    }
+    if (!testBits(key)) return New;
+    Metrics::count("request_key_bloom_maybe_total");
+    return Maybe;
+}
+
+void RequestKeyFilter::add(const QString &key) {
+    if (!m_loaded) return; // 尚未加载时无需维护，加载时会读到库中的键
+    setBits(key);
+    m_keyCount++;
+
+    QString &slot = m_ring[m_ringPos];
+    if (!slot.isEmpty()) m_recent.remove(slot);
+    slot = key;
+    m_recent.insert(key);
+    m_ringPos = (m_ringPos + 1) % WindowSize;
+}
@@ -0,0 +1,55 @@
+#ifndef REQUESTKEYFILTER_H
+#define REQUESTKEYFILTER_H
+
+#include <QString>
+#include <QVector>
+#include <QSet>
+
+// 出入库幂等键的内存预判：终端超时重试时会带着同一个键重复提交
+//
+// 布隆过滤器覆盖库中全部已有的键，判定"没见过"时一定是新请求，无需查库；
+// 最近提交的键另存一个定长环形窗口（精确集合），重试通常落在窗口内，直接判为重复。
+// 只有布隆过滤器命中但不在窗口内时，才需要按唯一索引查库确认。
+// 首次使用时从 records 加载，键数超过容量后自动按新规模重建。
+// 只在界面线程中使用。
+class RequestKeyFilter
+{
+public:
+    enum Result {
+        New,        // 一定没有出现过
+        Duplicate,  // 一定出现过
+        Maybe       // 可能出现过，需要查库
+    };
+
+    static RequestKeyFilter& instance();
+
+    Result check(const QString &key);
+    // 需要时（首次使用、invalidate 之后或键数超过容量）从 records 整体加载；
+    // 要扫描全部幂等键，出入库应在开启写事务之前调用，避免事务中持有写锁做全表扫描
+    void ensureLoaded();
+    void add(const QString &key);           // 事务提交后登记
+    void invalidate() { m_loaded = false; } // 恢复快照等整体替换记录后调用
+
+private:
+    static const int WindowSize = 65536; // 精确窗口保存的最近键数
+    static const int HashCount = 7;      // 约 10 bit/键时误判率 ~1%
+
+    RequestKeyFilter();
+    RequestKeyFilter(const RequestKeyFilter&) = delete;
+    RequestKeyFilter& operator=(const RequestKeyFilter&) = delete;
+
+    void setBits(const QString &key);
+    bool testBits(const QString &key) const;
+
+    bool m_loaded;
+    QVector<quint64> m_bits;
+    quint64 m_bitCount;
+    qint64 m_keyCount;   // 已登记的键数
+    qint64 m_capacity;   // 按当前位数组规模能容纳的键数
+
+    QSet<QString> m_recent;
+    QVector<QString> m_ring;
+    int m_ringPos;
+};
+
+#endif // REQUESTKEYFILTER_H
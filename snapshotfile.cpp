@@ -0,0 +1,462 @@
+#include "snapshotfile.h"
+#include <QIODevice>
+#include <QDateTime>
+#include <QtEndian>
+#include <cstring>
+
+static const quint16 FormatVersion = 1;
+static const int HeaderSize = 24;
+static const quint32 FlagCompressed = 0x1;
+
+enum : quint8 {
+    EncodingRaw = 0,
+    EncodingZlib = 1
+};
+
+// --- 编码辅助函数 ---
+
+static quint32 blockCrc32(const uchar *data, qint64 len) {
+    static quint32 table[256];
+    static bool ready = [] {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            table[i] = c;
+        }
+        return true;
+    }();
+    Q_UNUSED(ready);
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (qint64 i = 0; i < len; ++i)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static inline quint64 zigzag(qint64 v) { return (quint64(v) << 1) ^ quint64(v >> 63); }
+static inline qint64 unzigzag(quint64 v) { return qint64(v >> 1) ^ -qint64(v & 1); }
+
+static void putU8(QByteArray &buf, quint8 v) { buf.append(char(v)); }
+
+template <typename T>
+static void putLE(QByteArray &buf, T v) {
+    uchar tmp[sizeof(T)];
+    qToLittleEndian<T>(v, tmp);
+    buf.append(reinterpret_cast<const char *>(tmp), sizeof(T));
+}
+
+static void putVarint(QByteArray &buf, quint64 v) {
+    while (v >= 0x80) {
+        buf.append(char((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    buf.append(char(v));
+}
+
+static void putString(QByteArray &buf, const QString &s) {
+    const QByteArray utf8 = s.toUtf8();
+    putVarint(buf, quint64(utf8.size()));
+    buf.append(utf8);
+}
+
+static bool getVarint(const uchar *&p, const uchar *end, quint64 *v) {
+    quint64 result = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uchar b = *p++;
+        result |= quint64(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+QVariant SnapshotColumnData::value(SnapshotType type, int row) const {
+    switch (type) {
+    case SnapshotType::Int64: return QVariant(qlonglong(ints.at(row)));
+    case SnapshotType::Float64: return QVariant(doubles.at(row));
+    case SnapshotType::String: return QVariant(strings.at(row));
+    }
+    return QVariant();
+}
+
+// --- 写入 ---
+
+SnapshotWriter::SnapshotWriter(QIODevice *out, bool compress)
+    : m_out(out), m_compress(compress), m_bufferedRows(0), m_tableRows(0) {}
+
+bool SnapshotWriter::writeBytes(const QByteArray &data) {
+    if (m_out->write(data) != data.size()) {
+        m_error = "写入快照文件失败: " + m_out->errorString();
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotWriter::writeHeader(int tableCount) {
+    QByteArray header("WHSNAP", 6);
+    putLE<quint16>(header, FormatVersion);
+    putLE<quint32>(header, m_compress ? FlagCompressed : 0);
+    putLE<qint64>(header, QDateTime::currentSecsSinceEpoch());
+    putLE<quint32>(header, quint32(tableCount));
+    return writeBytes(header);
+}
+
+bool SnapshotWriter::beginTable(const QString &name, const QList<SnapshotColumn> &columns) {
+    m_columns = columns;
+    m_buffer = QVector<SnapshotColumnData>(columns.size());
+    m_bufferedRows = 0;
+    m_tableRows = 0;
+
+    QByteArray buf;
+    putU8(buf, 'T');
+    putString(buf, name);
+    putVarint(buf, quint64(columns.size()));
+    for (const SnapshotColumn &c : columns) {
+        putString(buf, c.name);
+        putU8(buf, quint8(c.type));
+    }
+    return writeBytes(buf);
+}
+
+bool SnapshotWriter::appendRow(const QVariantList &values) {
+    if (values.size() != m_columns.size()) {
+        m_error = "列数与表头不一致";
+        return false;
+    }
+    for (int i = 0; i < values.size(); ++i) {
+        SnapshotColumnData &col = m_buffer[i];
+        switch (m_columns.at(i).type) {
+        case SnapshotType::Int64: col.ints.append(values.at(i).toLongLong()); break;
+        case SnapshotType::Float64: col.doubles.append(values.at(i).toDouble()); break;
+        case SnapshotType::String: col.strings.append(values.at(i).toString()); break;
+        }
+    }
+    if (++m_bufferedRows >= BlockRows)
+        return flushBlock();
+    return true;
+}
+
+QByteArray SnapshotWriter::encodeColumn(int col) const {
+    const SnapshotColumnData &data = m_buffer.at(col);
+    QByteArray buf;
+
+    switch (m_columns.at(col).type) {
+    case SnapshotType::Int64: {
+        buf.reserve(data.ints.size() * 2);
+        qint64 prev = 0;
+        for (qint64 v : data.ints) {
+            putVarint(buf, zigzag(v - prev));
+            prev = v;
+        }
+        break;
+    }
+    case SnapshotType::Float64: {
+        buf.reserve(data.doubles.size() * 8);
+        for (double v : data.doubles) {
+            quint64 bits;
+            std::memcpy(&bits, &v, sizeof(bits));
+            putLE<quint64>(buf, bits);
+        }
+        break;
+    }
+    case SnapshotType::String: {
+        //块内字典编码：先写字典，再写每行的下标
+        QHash<QString, quint32> dict;
+        QVector<quint32> indices;
+        QByteArray entries;
+        indices.reserve(data.strings.size());
+        for (const QString &s : data.strings) {
+            auto it = dict.constFind(s);
+            if (it == dict.constEnd()) {
+                it = dict.insert(s, quint32(dict.size()));
+                putString(entries, s);
+            }
+            indices.append(it.value());
+        }
+        putVarint(buf, quint64(dict.size()));
+        buf.append(entries);
+        for (quint32 idx : indices) putVarint(buf, idx);
+        break;
+    }
+    }
+    return buf;
+}
+
+bool SnapshotWriter::flushBlock() {
+    if (m_bufferedRows == 0) return true;
+
+    QByteArray buf;
+    putU8(buf, 'B');
+    putLE<quint32>(buf, quint32(m_bufferedRows));
+
+    for (int i = 0; i < m_columns.size(); ++i) {
+        const QByteArray raw = encodeColumn(i);
+        QByteArray stored = raw;
+        quint8 encoding = EncodingRaw;
+        if (m_compress) {
+            //qCompress 自带 4 字节长度前缀，这里去掉，原始长度另行记录
+            QByteArray packed = qCompress(raw, 1);
+            if (packed.size() - 4 < raw.size()) {
+                stored = packed.mid(4);
+                encoding = EncodingZlib;
+            }
+        }
+        putU8(buf, encoding);
+        putLE<quint32>(buf, quint32(raw.size()));
+        putLE<quint32>(buf, quint32(stored.size()));
+        putLE<quint32>(buf, blockCrc32(reinterpret_cast<const uchar *>(stored.constData()), stored.size()));
+        buf.append(stored);
+
+        SnapshotColumnData &col = m_buffer[i];
+        col.ints.clear();
+        col.doubles.clear();
+        col.strings.clear();
+    }
+
+    m_tableRows += quint64(m_bufferedRows);
+    m_bufferedRows = 0;
+    return writeBytes(buf);
+}
+
+bool SnapshotWriter::endTable() {
+    if (!flushBlock()) return false;
+    QByteArray buf;
+    putU8(buf, 'E');
+    putLE<quint64>(buf, m_tableRows);
+    return writeBytes(buf);
+}
+
+bool SnapshotWriter::finish() {
+    QByteArray buf;
+    putU8(buf, 'Z');
+    return writeBytes(buf);
+}
+
+// --- 读取 ---
+
+SnapshotReader::SnapshotReader()
+    : m_data(nullptr), m_size(0), m_pos(0), m_inTable(false), m_tableCount(0), m_tablesRead(0), m_tableRows(0) {}
+
+SnapshotReader::~SnapshotReader() {
+    if (m_data) m_file.unmap(const_cast<uchar *>(m_data));
+}
+
+bool SnapshotReader::fail(const QString &msg) {
+    if (m_error.isEmpty()) m_error = msg;
+    return false;
+}
+
+bool SnapshotReader::open(const QString &path) {
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return fail("无法打开快照文件");
+
+    m_size = m_file.size();
+    if (m_size < HeaderSize)
+        return fail("快照文件不完整");
+
+    m_data = m_file.map(0, m_size);
+    if (!m_data)
+        return fail("无法映射快照文件: " + m_file.errorString());
+
+    if (std::memcmp(m_data, "WHSNAP", 6) != 0)
+        return fail("不是有效的快照文件");
+    if (qFromLittleEndian<quint16>(m_data + 6) != FormatVersion)
+        return fail("不支持的快照版本");
+
+    m_tableCount = qFromLittleEndian<quint32>(m_data + 20);
+    m_tablesRead = 0;
+    m_pos = HeaderSize;
+    return true;
+}
+
+bool SnapshotReader::readU8(quint8 *v) {
+    if (m_pos + 1 > m_size) return fail("快照文件被截断");
+    *v = m_data[m_pos++];
+    return true;
+}
+
+bool SnapshotReader::readU32(quint32 *v) {
+    if (m_pos + 4 > m_size) return fail("快照文件被截断");
+    *v = qFromLittleEndian<quint32>(m_data + m_pos);
+    m_pos += 4;
+    return true;
+}
+
+bool SnapshotReader::readU64(quint64 *v) {
+    if (m_pos + 8 > m_size) return fail("快照文件被截断");
+    *v = qFromLittleEndian<quint64>(m_data + m_pos);
+    m_pos += 8;
+    return true;
+}
+
+bool SnapshotReader::readVarint(quint64 *v) {
+    const uchar *p = m_data + m_pos;
+    if (!getVarint(p, m_data + m_size, v)) return fail("快照文件被截断");
+    m_pos = p - m_data;
+    return true;
+}
+
+bool SnapshotReader::readString(QString *s) {
+    quint64 len;
+    if (!readVarint(&len)) return false;
+    if (len > quint64(m_size - m_pos)) return fail("快照文件被截断");
+    *s = QString::fromUtf8(reinterpret_cast<const char *>(m_data + m_pos), int(len));
+    m_pos += qint64(len);
+    return true;
+}
+
+bool SnapshotReader::nextTable(QString *name, QList<SnapshotColumn> *columns) {
+    if (m_inTable) return fail("上一个表尚未读完");
+
+    quint8 tag;
+    if (!readU8(&tag)) return false;
+    //文件尾：表的个数须与文件头一致，否则文件被截断或拼接过
+    if (tag == 'Z') {
+        if (m_tablesRead != m_tableCount)
+            return fail(QString("快照表数量不符（文件头 %1，实际 %2）").arg(m_tableCount).arg(m_tablesRead));
+        return false;
+    }
+    if (tag != 'T') return fail("快照文件格式错误");
+    if (m_tablesRead >= m_tableCount) return fail("快照表数量超出文件头");
+
+    quint64 count;
+    if (!readString(name) || !readVarint(&count)) return false;
+    if (count == 0 || count > 256) return fail("快照表头错误");
+
+    columns->clear();
+    for (quint64 i = 0; i < count; ++i) {
+        SnapshotColumn c;
+        quint8 type;
+        if (!readString(&c.name) || !readU8(&type)) return false;
+        if (type < quint8(SnapshotType::Int64) || type > quint8(SnapshotType::String))
+            return fail("未知的列类型");
+        c.type = SnapshotType(type);
+        columns->append(c);
+    }
+
+    m_columns = *columns;
+    m_inTable = true;
+    m_tableRows = 0;
+    m_tablesRead++;
+    return true;
+}
+
+bool SnapshotReader::nextBlock(QVector<SnapshotColumnData> *block, int *rows) {
+    if (!m_inTable) return false;
+
+    quint8 tag;
+    if (!readU8(&tag)) return false;
+    if (tag == 'E') {
+        //表尾：总行数须与各数据块的行数之和一致
+        quint64 total;
+        m_inTable = false;
+        if (!readU64(&total)) return false;
+        if (total != m_tableRows)
+            return fail(QString("快照表行数不符（表尾 %1，实际 %2）").arg(total).arg(m_tableRows));
+        return false;
+    }
+    if (tag != 'B') return fail("快照文件格式错误");
+
+    quint32 rowCount;
+    if (!readU32(&rowCount)) return false;
+    if (rowCount > 16 * 1024 * 1024) return fail("数据块行数异常");
+
+    block->resize(m_columns.size());
+    for (int i = 0; i < m_columns.size(); ++i) {
+        quint8 encoding;
+        quint32 rawSize, storedSize, crc;
+        if (!readU8(&encoding) || !readU32(&rawSize) || !readU32(&storedSize) || !readU32(&crc))
+            return false;
+        if (storedSize > quint64(m_size - m_pos)) return fail("快照文件被截断");
+
+        const uchar *stored = m_data + m_pos;
+        m_pos += storedSize;
+        if (blockCrc32(stored, storedSize) != crc)
+            return fail(QString("数据块校验失败（偏移 %1）").arg(m_pos - storedSize));
+
+        QByteArray raw;
+        if (encoding == EncodingZlib) {
+            //补回 qUncompress 需要的大端长度前缀
+            QByteArray packed;
+            packed.reserve(int(storedSize) + 4);
+            uchar len[4];
+            qToBigEndian<quint32>(rawSize, len);
+            packed.append(reinterpret_cast<const char *>(len), 4);
+            packed.append(reinterpret_cast<const char *>(stored), int(storedSize));
+            raw = qUncompress(packed);
+            if (raw.size() != int(rawSize)) return fail("数据块解压失败");
+        } else if (encoding == EncodingRaw) {
+            //未压缩的块直接引用映射内存，不做拷贝
+            raw = QByteArray::fromRawData(reinterpret_cast<const char *>(stored), int(storedSize));
+        } else {
+            return fail("未知的数据块编码");
+        }
+
+        if (!decodeColumn(m_columns.at(i).type, raw, int(rowCount), &(*block)[i]))
+            return false;
+    }
+
+    *rows = int(rowCount);
+    m_tableRows += rowCount;
+    return true;
+}
+
+bool SnapshotReader::decodeColumn(SnapshotType type, const QByteArray &raw, int rows,
+                                  SnapshotColumnData *out) {
+    const uchar *p = reinterpret_cast<const uchar *>(raw.constData());
+    const uchar *end = p + raw.size();
+    out->ints.clear();
+    out->doubles.clear();
+    out->strings.clear();
+
+    switch (type) {
+    case SnapshotType::Int64: {
+        out->ints.reserve(rows);
+        qint64 prev = 0;
+        for (int r = 0; r < rows; ++r) {
+            quint64 z;
+            if (!getVarint(p, end, &z)) return fail("整数列数据损坏");
+            prev += unzigzag(z);
+            out->ints.append(prev);
+        }
+        return true;
+    }
+    case SnapshotType::Float64: {
+        if (end - p < qint64(rows) * 8) return fail("浮点列数据损坏");
+        out->doubles.reserve(rows);
+        for (int r = 0; r < rows; ++r) {
+            quint64 bits = qFromLittleEndian<quint64>(p);
+            double v;
+            std::memcpy(&v, &bits, sizeof(v));
+            out->doubles.append(v);
+            p += 8;
+        }
+        return true;
+    }
+    case SnapshotType::String: {
+        quint64 dictSize;
+        if (!getVarint(p, end, &dictSize) || dictSize > quint64(rows))
+            return fail("字符串字典损坏");
+        QVector<QString> dict;
+        dict.reserve(int(dictSize));
+        for (quint64 i = 0; i < dictSize; ++i) {
+            quint64 len;
+            if (!getVarint(p, end, &len) || len > quint64(end - p)) return fail("字符串字典损坏");
+            dict.append(QString::fromUtf8(reinterpret_cast<const char *>(p), int(len)));
+            p += len;
+        }
+        out->strings.reserve(rows);
+        for (int r = 0; r < rows; ++r) {
+            quint64 idx;
+            if (!getVarint(p, end, &idx) || idx >= dictSize) return fail("字符串列数据损坏");
+            out->strings.append(dict.at(int(idx)));
+        }
+        return true;
+    }
+    }
+    return fail("未知的列类型");
+}
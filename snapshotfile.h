@@ -0,0 +1,114 @@
+#ifndef SNAPSHOTFILE_H
+#define SNAPSHOTFILE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+#include <QFile>
+#include <QHash>
+#include <QVariant>
+
+class QIODevice;
+
+// 二进制列式快照格式（.whs / .whsz），用于备份和站点间传输
+//
+// 文件结构（小端）:
+//   文件头   "WHSNAP" u16 版本 | u32 标志(bit0 压缩) | i64 创建时间 | u32 表数量
+//   表头     'T' | 表名 | 列数 | 每列: 列名 + u8 类型
+//   数据块   'B' | u32 行数 | 每列: u8 编码 | u32 原始长度 | u32 存储长度 | u32 CRC32 | 数据
+//   表尾     'E' | u64 总行数
+//   文件尾   'Z'
+// 整数列按 zigzag 差分 + varint 存储（适合自增 id 和时间戳），
+// 字符串列每块一个字典 + varint 下标，浮点列原样存 8 字节。
+// 压缩使用 zlib (qCompress)，仅在确实变小时才启用。
+
+enum class SnapshotType : quint8 {
+    Int64 = 1,
+    Float64 = 2,
+    String = 3
+};
+
+struct SnapshotColumn {
+    QString name;
+    SnapshotType type;
+};
+
+// 解码后的一个列块
+struct SnapshotColumnData {
+    QVector<qint64> ints;
+    QVector<double> doubles;
+    QVector<QString> strings;
+
+    QVariant value(SnapshotType type, int row) const;
+};
+
+class SnapshotWriter
+{
+public:
+    static const int BlockRows = 65536; // 每块最多行数
+
+    SnapshotWriter(QIODevice *out, bool compress);
+
+    bool writeHeader(int tableCount);
+    bool beginTable(const QString &name, const QList<SnapshotColumn> &columns);
+    bool appendRow(const QVariantList &values); // 按列顺序追加一行，满一块自动写出
+    bool endTable();
+    bool finish();
+
+    QString errorString() const { return m_error; }
+
+private:
+    bool flushBlock();
+    QByteArray encodeColumn(int col) const;
+    bool writeBytes(const QByteArray &data);
+
+    QIODevice *m_out;
+    bool m_compress;
+    QString m_error;
+
+    QList<SnapshotColumn> m_columns;
+    QVector<SnapshotColumnData> m_buffer;
+    int m_bufferedRows;
+    quint64 m_tableRows;
+};
+
+class SnapshotReader
+{
+public:
+    SnapshotReader();
+    ~SnapshotReader();
+
+    bool open(const QString &path); // 以内存映射方式打开并校验文件头
+
+    // 依次读取表；没有更多表时返回 false（同时检查 errorString() 区分出错与结束）
+    bool nextTable(QString *name, QList<SnapshotColumn> *columns);
+    // 读取当前表的下一个数据块；表读完时返回 false（表尾总行数不符时同时设置 errorString()）
+    bool nextBlock(QVector<SnapshotColumnData> *block, int *rows);
+
+    qint64 position() const { return m_pos; }
+    qint64 size() const { return m_size; }
+    QString errorString() const { return m_error; }
+
+private:
+    bool fail(const QString &msg);
+    bool readU8(quint8 *v);
+    bool readU32(quint32 *v);
+    bool readU64(quint64 *v);
+    bool readVarint(quint64 *v);
+    bool readString(QString *s);
+    bool decodeColumn(SnapshotType type, const QByteArray &raw, int rows, SnapshotColumnData *out);
+
+    QFile m_file;
+    const uchar *m_data;
+    qint64 m_size;
+    qint64 m_pos;
+    bool m_inTable;
+    quint32 m_tableCount;  // 文件头中的表数量
+    quint32 m_tablesRead;
+    quint64 m_tableRows;   // 当前表已读的行数，与表尾的总行数核对
+    QList<SnapshotColumn> m_columns;
+    QString m_error;
+};
+
+#endif // SNAPSHOTFILE_H
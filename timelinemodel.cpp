@@ -0,0 +1,98 @@
+#include "timelinemodel.h"
+#include "dbmanager.h"
+#include "metrics.h"
+#include <QBrush>
+
+TimelineModel::TimelineModel(QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_productId(-1)
+    , m_nextBalance(0)
+    , m_atEnd(true)
+{
+    m_headers << "时间" << "类型" << "仓库" << "变动数量" << "结存" << "备注";
+}
+
+void TimelineModel::setProduct(int productId, int currentQuantity) {
+    beginResetModel();
+    m_productId = productId;
+    m_nextBalance = currentQuantity;
+    m_atEnd = false;
+    m_records.clear();
+    m_balance.clear();
+    endResetModel();
+    fetchMore(QModelIndex());
+}
+
+int TimelineModel::rowCount(const QModelIndex &parent) const {
+    if (parent.isValid()) return 0;
+    return m_records.size();
+}
+
+int TimelineModel::columnCount(const QModelIndex &parent) const {
+    if (parent.isValid()) return 0;
+    return m_headers.size();
+}
+
+bool TimelineModel::canFetchMore(const QModelIndex &parent) const {
+    return !parent.isValid() && !m_atEnd;
+}
+
+void TimelineModel::fetchMore(const QModelIndex &parent) {
+    if (parent.isValid() || m_atEnd) return;
+    ScopedTimer timer("model_timeline_fetch");
+
+    qint64 beforeTs = -1;
+    int beforeId = 0;
+    if (!m_records.isEmpty()) {
+        beforeTs = m_records.last().time.toSecsSinceEpoch();
+        beforeId = m_records.last().id;
+    }
+    const QList<Record> page = DbManager::instance().getProductRecords(m_productId, beforeTs, beforeId, PageSize);
+    if (page.size() < PageSize) m_atEnd = true;
+    if (page.isEmpty()) return;
+
+    beginInsertRows(QModelIndex(), m_records.size(), m_records.size() + page.size() - 1);
+    for (const Record &r : page) {
+        m_records.append(r);
+        m_balance.append(m_nextBalance);
+        m_nextBalance -= (r.type == 1) ? r.count : -r.count;
+    }
+    endInsertRows();
+    timer.setRows(page.size());
+}
+
+QVariant TimelineModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= m_records.size())
+        return QVariant();
+
+    const Record &r = m_records.at(index.row());
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+        case 0: return r.time.toString("yyyy-MM-dd HH:mm:ss");
+        case 1: return r.typeStr();
+        case 2: return r.locationName;
+        case 3: return (r.type == 1) ? QString("+%1").arg(r.count) : QString("-%1").arg(r.count);
+        case 4: return m_balance.at(index.row());
+        case 5: return r.remark;
+        }
+    }
+    else if (role == Qt::ForegroundRole) {
+        if (index.column() == 1 || index.column() == 3)
+            return (r.type == 1) ? QBrush(Qt::darkGreen) : QBrush(Qt::darkBlue);
+        if (index.column() == 4 && m_balance.at(index.row()) < 0)
+            return QBrush(Qt::red);
+    }
+    else if (role == Qt::TextAlignmentRole) {
+        return QVariant(Qt::AlignCenter);
+    }
+
+    return QVariant();
+}
+
+QVariant TimelineModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role == Qt::DisplayRole && orientation == Qt::Horizontal) {
+        return m_headers.value(section);
+    }
+    return QVariant();
+}
@@ -0,0 +1,38 @@
+#ifndef TIMELINEMODEL_H
+#define TIMELINEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include "warehousedata.h"
+
+// 单个货品的出入库流水（最新在前），带每条记录之后的结存
+// 按需分页加载：视图滚动到底部时 fetchMore() 再取一页，记录再多也只读取看得到的部分。
+// 结存从当前库存出发向过去倒推，每取一页只在上一页末尾的结存上继续累减。
+class TimelineModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    static const int PageSize = 500;
+
+    explicit TimelineModel(QObject *parent = nullptr);
+
+    void setProduct(int productId, int currentQuantity); // 切换货品并加载第一页
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+private:
+    int m_productId;
+    int m_nextBalance;      // 下一条（更早的）记录之后的结存
+    bool m_atEnd;
+    QVector<Record> m_records;
+    QVector<int> m_balance; // 与 m_records 一一对应
+    QStringList m_headers;
+};
+
+#endif // TIMELINEMODEL_H
@@ -0,0 +1,87 @@
+#include "undocommands.h"
+#include "dbmanager.h"
+
+QString UndoCommands::s_lastError;
+
+void UndoCommands::fail(QUndoCommand *cmd, const QString &error) {
+    s_lastError = QString("%1 失败: %2").arg(cmd->text(), error);
+    cmd->setObsolete(true);
+}
+
+MovementCommand::MovementCommand(const StockMovement &move, const QString &productText)
+    : m_move(move), m_firstRedo(true)
+{
+    setText(QString("%1 %2 × %3").arg(move.isInbound ? "入库" : "出库", productText).arg(move.count));
+}
+
+void MovementCommand::undo() {
+    QString error = DbManager::instance().adjustStock(m_move.productId, m_move.count, !m_move.isInbound,
+                                                      "撤销: " + m_move.remark, m_move.locationId);
+    if (!error.isEmpty()) UndoCommands::fail(this, error);
+}
+
+void MovementCommand::redo() {
+    if (m_firstRedo) {
+        m_firstRedo = false;
+        return;
+    }
+    QString error = DbManager::instance().adjustStock(m_move.productId, m_move.count, m_move.isInbound,
+                                                      "重做: " + m_move.remark, m_move.locationId);
+    if (!error.isEmpty()) UndoCommands::fail(this, error);
+}
+
+ProductCommand::ProductCommand(Kind kind, const Product &before, const Product &after)
+    : m_kind(kind), m_before(before), m_after(after), m_firstRedo(true)
+{
+    switch (kind) {
+    case Add: setText("新增货品 " + after.code); break;
+    case Update: setText("修改货品 " + after.code); break;
+    case Delete: setText("删除货品 " + before.code); break;
+    }
+}
+
+//新增 / 删除都是软删除标记的切换，货品ID和历史记录保持不变
+void ProductCommand::undo() {
+    bool ok = false;
+    switch (m_kind) {
+    case Add: ok = DbManager::instance().deleteProduct(m_after.id); break;
+    case Update: ok = DbManager::instance().updateProduct(m_before); break;
+    case Delete: ok = DbManager::instance().restoreProduct(m_before.id); break;
+    }
+    if (!ok) UndoCommands::fail(this, "数据库写入失败");
+}
+
+void ProductCommand::redo() {
+    if (m_firstRedo) {
+        m_firstRedo = false;
+        return;
+    }
+    bool ok = false;
+    switch (m_kind) {
+    case Add: ok = DbManager::instance().restoreProduct(m_after.id); break;
+    case Update: ok = DbManager::instance().updateProduct(m_after); break;
+    case Delete: ok = DbManager::instance().deleteProduct(m_before.id); break;
+    }
+    if (!ok) UndoCommands::fail(this, "数据库写入失败");
+}
+
+ProductBatchCommand::ProductBatchCommand(const QList<Product> &before, const QList<Product> &after)
+    : m_before(before), m_after(after), m_firstRedo(true)
+{
+    setText(after.size() == 1 ? "修改货品 " + after.first().code
+                              : QString("批量修改 %1 个货品").arg(after.size()));
+}
+
+void ProductBatchCommand::undo() {
+    if (!DbManager::instance().updateProductsBatch(m_before))
+        UndoCommands::fail(this, "数据库写入失败");
+}
+
+void ProductBatchCommand::redo() {
+    if (m_firstRedo) {
+        m_firstRedo = false;
+        return;
+    }
+    if (!DbManager::instance().updateProductsBatch(m_after))
+        UndoCommands::fail(this, "数据库写入失败");
+}
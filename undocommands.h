@@ -0,0 +1,69 @@
+#ifndef UNDOCOMMANDS_H
+#define UNDOCOMMANDS_H
+
+#include <QUndoCommand>
+#include "warehousedata.h"
+
+// 撤销 / 重做命令
+// 命令在操作已经成功执行之后才压栈，第一次 redo() 不再重复执行。
+// 出入库从不修改或删除已有记录：撤销时记一笔方向相反的冲正记录，重做时再记一笔原方向的记录。
+// 撤销 / 重做失败（例如冲正入库时库存已不足）时命令标记为 obsolete，由 QUndoStack 移出栈，
+// 失败原因通过 lastError() 取得。
+class UndoCommands
+{
+public:
+    static QString lastError() { return s_lastError; }
+    static void clearError() { s_lastError.clear(); }
+    static void fail(QUndoCommand *cmd, const QString &error);
+
+private:
+    static QString s_lastError;
+};
+
+class MovementCommand : public QUndoCommand
+{
+public:
+    MovementCommand(const StockMovement &move, const QString &productText);
+
+    void undo() override;
+    void redo() override;
+
+private:
+    StockMovement m_move;
+    bool m_firstRedo;
+};
+
+class ProductCommand : public QUndoCommand
+{
+public:
+    enum Kind { Add, Update, Delete };
+
+    // before / after 分别为操作前后的货品资料（新增时 before 无意义，删除时 after 无意义）
+    ProductCommand(Kind kind, const Product &before, const Product &after);
+
+    void undo() override;
+    void redo() override;
+
+private:
+    Kind m_kind;
+    Product m_before;
+    Product m_after;
+    bool m_firstRedo;
+};
+
+// 库存表里批量修改（直接编辑、批量调价）一次保存的全部货品，撤销 / 重做也是一个事务
+class ProductBatchCommand : public QUndoCommand
+{
+public:
+    ProductBatchCommand(const QList<Product> &before, const QList<Product> &after);
+
+    void undo() override;
+    void redo() override;
+
+private:
+    QList<Product> m_before;
+    QList<Product> m_after;
+    bool m_firstRedo;
+};
+
+#endif // UNDOCOMMANDS_H
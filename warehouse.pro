@@ -1,27 +1,64 @@
-QT       += core gui sql
+QT       += core gui sql concurrent network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
 
+# 在线备份：找到系统 SQLite 的开发文件时用备份 API 分步复制（有进度、可取消），
+# 程序自己打开两边的连接，不使用 Qt 驱动内部的句柄（此时 Qt 也应使用系统 SQLite，
+# 进程里只有一份 SQLite 库）；找不到时退回 VACUUM INTO 一次复制。恢复始终经由 Qt 驱动
+packagesExist(sqlite3) {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += sqlite3
+    DEFINES += WAREHOUSE_SQLITE_API
+}
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    csvreader.cpp \
+    datasnapshot.cpp \
     dataworker.cpp \
     dbmanager.cpp \
+    forecaster.cpp \
+    ingestserver.cpp \
+    locationstock.cpp \
+    lowstockmonitor.cpp \
     main.cpp \
     mainwindow.cpp \
+    metrics.cpp \
+    metricsdock.cpp \
+    productfilterproxy.cpp \
     productmodel.cpp \
-    recordmodel.cpp
+    recordmodel.cpp \
+    reportengine.cpp \
+    requestkeyfilter.cpp \
+    snapshotfile.cpp \
+    timelinemodel.cpp \
+    undocommands.cpp
 
 HEADERS += \
+    csvreader.h \
+    datasnapshot.h \
     dataworker.h \
     dbmanager.h \
+    forecaster.h \
+    ingestserver.h \
+    locationstock.h \
+    lowstockmonitor.h \
     mainwindow.h \
+    metrics.h \
+    metricsdock.h \
+    productfilterproxy.h \
     productmodel.h \
     recordmodel.h \
+    reportengine.h \
+    requestkeyfilter.h \
+    snapshotfile.h \
+    timelinemodel.h \
+    undocommands.h \
     warehousedata.h
 
 FORMS += \
@@ -4,6 +4,16 @@
 #include <QString>
 #include <QDateTime>
 
+// 默认仓库：升级前的库存和未指定仓库的操作都归入这里
+const int DefaultLocationId = 1;
+
+// 仓库 / 库位
+struct Location {
+    int id;
+    QString code;       // 编号 (唯一)
+    QString name;       // 名称
+};
+
 // 货品结构体
 struct Product {
     int id;
@@ -25,16 +35,31 @@ struct Product {
 struct Record {
     int id;
     int productId;      // 关联的货品ID
-    QString productName;// 冗余存一个名称，方便显示（可选）
+    QString productCode;// 记账时的货品编号（冗余存储，读取历史不再关联货品表）
+    QString productName;// 记账时的货品名称
     int type;           // 1: 入库, 0: 出库
     int count;          // 数量
     QDateTime time;     // 操作时间
     QString remark;     // 备注
+    int locationId;     // 所在仓库
+    QString locationName;
+    int peerLocationId; // 调拨时对方仓库，非调拨为 0
 
     QString typeStr() const {
+        if (peerLocationId != 0) return (type == 1) ? "调入" : "调出";
         return (type == 1) ? "入库" : "出库";
     }
 };
 
+// 出入库请求（批量接口使用）
+struct StockMovement {
+    int productId;
+    int count;
+    bool isInbound;
+    QString remark;
+    int locationId = DefaultLocationId;
+    QString requestKey; // 客户端生成的幂等键（可选），重试时使用同一个键不会重复记账
+};
+
 #endif // WAREHOUSEDATA_H
 